@@ -0,0 +1,337 @@
+#include <OpenMesh/Core/IO/MeshIO.hh>
+#include "LSCMSolver.h"
+#include "BinaryMesh.h"
+#include "DistortionMetrics.h"
+#include "Telemetry.h"
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Benchmark of the LSCM pipeline, one line per run and stage.
+//   para_bench [--solver cg|pcg|free|superlu|cholmod] [--multilevel] [--reorder]
+//              [--repeat n] [--synthetic faces[,faces...]] [--csv] [in.obj ...]
+//
+// Without inputs it runs face-1.obj, face-2.obj and dinosaur.obj from
+// the working directory (the Release folder) and two synthetic sheets.
+// Stages are load, setup (pins and initial guess), assemble, solve,
+// result (texcoords written back) and metrics (DistortionMetrics).
+// Output is JSON lines, or CSV with --csv. Peak memory is the highest
+// working set of the process during the stage, sampled every 10 ms by
+// a thread of its own and at both ends of the stage, so that a stage
+// freeing what the previous one allocated reports less. The solver
+// stages are timed by the solver's Telemetry.
+
+struct Options
+{
+  Options() : solver(LSCMSolver::SOLVER_CG), multilevel(false), reorder(false), repeat(1),
+              csv(false) {}
+
+  LSCMSolver::SolverType solver;
+  bool multilevel;
+  bool reorder;
+  int repeat;
+  bool csv;
+  std::vector<std::string> inputs;
+  std::vector<int> synthetic;
+};
+
+struct Stage
+{
+  const char* name;
+  double time;
+  double peak_mb;
+  int iterations;
+};
+
+static const char* solver_names[] = { "cg", "superlu", "cholmod", "pcg", "free" };
+
+static bool parse_solver(const char* _name, LSCMSolver::SolverType& _type)
+{
+  if      (!strcmp(_name, "cg"))      _type = LSCMSolver::SOLVER_CG;
+  else if (!strcmp(_name, "pcg"))     _type = LSCMSolver::SOLVER_PARALLEL_CG;
+  else if (!strcmp(_name, "free"))    _type = LSCMSolver::SOLVER_MATRIX_FREE_CG;
+  else if (!strcmp(_name, "superlu")) _type = LSCMSolver::SOLVER_SUPERLU;
+  else if (!strcmp(_name, "cholmod")) _type = LSCMSolver::SOLVER_CHOLMOD;
+  else return false;
+  return true;
+}
+
+// Wavy sheet of n x n vertices, about _faces triangles
+static void make_sheet(Mesh& _mesh, int _faces)
+{
+  int n = std::max(2, (int)std::sqrt(_faces / 2.0) + 1);
+  std::vector<Mesh::VertexHandle> vh;
+  vh.reserve(n * n);
+  for (int j = 0; j < n; j++)
+  {
+    for (int i = 0; i < n; i++)
+    {
+      float x = (float)i / (n - 1), y = (float)j / (n - 1);
+      float z = 0.1f * std::sin(6.0f * x) * std::cos(4.0f * y);
+      vh.push_back(_mesh.add_vertex(Mesh::Point(x, y, z)));
+    }
+  }
+  for (int j = 0; j + 1 < n; j++)
+  {
+    for (int i = 0; i + 1 < n; i++)
+    {
+      int v = j * n + i;
+      _mesh.add_face(vh[v], vh[v + 1], vh[v + n + 1]);
+      _mesh.add_face(vh[v], vh[v + n + 1], vh[v + n]);
+    }
+  }
+}
+
+static std::string json_escape(const std::string& _s)
+{
+  std::string out;
+  for (size_t i = 0; i < _s.size(); ++i)
+  {
+    if (_s[i] == '"' || _s[i] == '\\')
+      out += '\\';
+    out += _s[i];
+  }
+  return out;
+}
+
+static void report(const Options& _opt, const std::string& _input, const Mesh& _mesh,
+                   int _run, const std::vector<Stage>& _stages)
+{
+  double total = 0.0;
+  for (size_t s = 0; s < _stages.size(); s++)
+    total += _stages[s].time;
+
+  const char* solver = solver_names[_opt.solver];
+  for (size_t s = 0; s < _stages.size(); s++)
+  {
+    const Stage& st = _stages[s];
+    double fps = st.time > 0.0 ? _mesh.n_faces() / st.time : 0.0;
+    if (_opt.csv)
+    {
+      printf("%s,%s,%d,%d,%d,%d,%s,%.6f,%.1f,%.1f,%d\n", _input.c_str(), solver,
+             _opt.multilevel ? 1 : 0, _opt.reorder ? 1 : 0, _run, (int)_mesh.n_faces(), st.name,
+             st.time, fps, st.peak_mb, st.iterations);
+    }
+    else
+    {
+      printf("{\"input\":\"%s\",\"solver\":\"%s\",\"multilevel\":%s,\"reorder\":%s,\"run\":%d,"
+             "\"vertices\":%d,\"faces\":%d,\"stage\":\"%s\",\"time_s\":%.6f,"
+             "\"faces_per_s\":%.1f,\"peak_mb\":%.1f,\"iterations\":%d,\"total_s\":%.6f}\n",
+             json_escape(_input).c_str(), solver, _opt.multilevel ? "true" : "false",
+             _opt.reorder ? "true" : "false", _run,
+             (int)_mesh.n_vertices(), (int)_mesh.n_faces(), st.name, st.time,
+             fps, st.peak_mb, st.iterations, total);
+    }
+  }
+  fflush(stdout);
+}
+
+// Running maximum of the working set of the process, sampled every
+// 10 ms by a thread of its own until destroyed
+class MemorySampler
+{
+public:
+  MemorySampler() : peak_(0.0), running_(true), thread_(&MemorySampler::sample, this) {}
+  ~MemorySampler()
+  {
+    running_ = false;
+    thread_.join();
+  }
+
+  // highest working set since the last call, at least the current
+  // one, so that a stage shorter than the period still gets a value
+  double next()
+  {
+    double mb = Telemetry::current_memory_mb();
+    std::lock_guard<std::mutex> lock(mutex_);
+    double peak = std::max(peak_, mb);
+    peak_ = mb;
+    return peak;
+  }
+
+private:
+  void sample()
+  {
+    while (running_)
+    {
+      double mb = Telemetry::current_memory_mb();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        peak_ = std::max(peak_, mb);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  double peak_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+};
+
+// peak of the solver stages _first to _last
+static double solver_peak(const Telemetry& _telemetry, const char* _first, const char* _last)
+{
+  double mb = 0.0;
+  bool inside = false;
+  const std::vector<Telemetry::Stage>& stages = _telemetry.stages();
+  for (size_t s = 0; s < stages.size(); s++)
+  {
+    if (stages[s].name == _first)
+      inside = true;
+    if (inside)
+      mb = std::max(mb, stages[s].peak_mb);
+    if (stages[s].name == _last)
+      break;
+  }
+  return mb;
+}
+
+// _faces > 0 generates a synthetic sheet instead of loading _input
+static bool run(const Options& _opt, const std::string& _input, int _faces, int _run,
+                MemorySampler& _memory)
+{
+  std::vector<Stage> stages;
+  Mesh mesh;
+  mesh.request_vertex_texcoords2D();
+
+  _memory.next();
+  double t0 = omp_get_wtime();
+  if (_faces > 0)
+    make_sheet(mesh, _faces);
+  else if (!BinaryMesh::read_mesh(mesh, _input))
+  {
+    std::cerr << _input << ": cannot read mesh\n";
+    return false;
+  }
+  double t1 = omp_get_wtime();
+  Stage load = { "load", t1 - t0, _memory.next(), 0 };
+  stages.push_back(load);
+
+  Telemetry telemetry;
+  LSCMSolver solver(mesh);
+  telemetry.set_memory_probe([&_memory]() { return _memory.next(); });
+  solver.set_telemetry(&telemetry);
+  solver.set_solver(_opt.solver);
+  solver.set_multilevel(_opt.multilevel);
+  solver.set_reorder(_opt.reorder);
+  if (!solver.solve())
+  {
+    std::cerr << _input << ": parameterization failed\n";
+    return false;
+  }
+
+  // setup runs from bbox to init_slover, assemble is setup_LSCM
+  const LSCMSolver::Timings& t = solver.timings();
+  Stage setup    = { "setup",    t.setup,    solver_peak(telemetry, "bbox", "init_slover"), 0 };
+  Stage assemble = { "assemble", t.assemble, solver_peak(telemetry, "setup_LSCM", "setup_LSCM"), 0 };
+  Stage solve    = { "solve",    t.solve,    solver_peak(telemetry, "solve", "solve"),
+                     solver.used_iterations() };
+  Stage result   = { "result",   t.result,   solver_peak(telemetry, "get_result", "get_result"), 0 };
+  stages.push_back(setup);
+  stages.push_back(assemble);
+  stages.push_back(solve);
+  stages.push_back(result);
+
+  DistortionMetrics metrics(mesh);
+  _memory.next();
+  metrics.compute();
+  Stage quality = { "metrics", metrics.time(), _memory.next(), 0 };
+  stages.push_back(quality);
+
+  report(_opt, _input, mesh, _run, stages);
+  return true;
+}
+
+
+static int usage(const char* _prog)
+{
+  std::cerr << "usage: " << _prog
+            << " [--solver cg|pcg|free|superlu|cholmod] [--multilevel] [--reorder]\n"
+            << "       [--repeat n] [--synthetic faces[,faces...]] [--csv] [in.obj ...]\n";
+  return 1;
+}
+
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  bool synthetic_set = false;
+
+  int i = 1;
+  for (; i < argc && !strncmp(argv[i], "--", 2); ++i)
+  {
+    if (!strcmp(argv[i], "--solver") && i + 1 < argc)
+    {
+      if (!parse_solver(argv[++i], opt.solver))
+        return usage(argv[0]);
+    }
+    else if (!strcmp(argv[i], "--multilevel"))
+      opt.multilevel = true;
+    else if (!strcmp(argv[i], "--reorder"))
+      opt.reorder = true;
+    else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+      opt.repeat = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "--synthetic") && i + 1 < argc)
+    {
+      synthetic_set = true;
+      for (const char* p = argv[++i]; *p; )
+      {
+        int faces = atoi(p);
+        if (faces > 0)
+          opt.synthetic.push_back(faces);
+        while (*p && *p != ',') ++p;
+        if (*p) ++p;
+      }
+    }
+    else if (!strcmp(argv[i], "--csv"))
+      opt.csv = true;
+    else
+      return usage(argv[0]);
+  }
+
+  for (; i < argc; ++i)
+    opt.inputs.push_back(argv[i]);
+
+  if (opt.inputs.empty() && !synthetic_set)
+  {
+    opt.inputs.push_back("face-1.obj");
+    opt.inputs.push_back("face-2.obj");
+    opt.inputs.push_back("dinosaur.obj");
+    opt.synthetic.push_back(100000);
+    opt.synthetic.push_back(400000);
+  }
+
+  if (opt.csv)
+    printf("input,solver,multilevel,reorder,run,faces,stage,time_s,faces_per_s,peak_mb,iterations\n");
+
+  MemorySampler memory;
+  int failed = 0;
+  for (int run_id = 0; run_id < opt.repeat; ++run_id)
+  {
+    for (size_t k = 0; k < opt.inputs.size(); ++k)
+    {
+      if (!run(opt, opt.inputs[k], 0, run_id, memory))
+        ++failed;
+    }
+    for (size_t k = 0; k < opt.synthetic.size(); ++k)
+    {
+      std::string name = "synthetic-" + std::to_string(opt.synthetic[k]);
+      if (!run(opt, name, opt.synthetic[k], run_id, memory))
+        ++failed;
+    }
+  }
+
+  return failed ? 2 : 0;
+}
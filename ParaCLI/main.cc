@@ -0,0 +1,571 @@
+#include <OpenMesh/Core/IO/MeshIO.hh>
+#include "LSCMSolver.h"
+#include "BinaryMesh.h"
+#include "ObjWriter.h"
+#include "ChartAtlas.h"
+#include "DistortionMetrics.h"
+#include "BatchScheduler.h"
+#include "Telemetry.h"
+#include "PreviewRenderer.h"
+#include "StreamingSolver.h"
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Headless LSCM: no GLUT window and no OpenGL context are created.
+//   para_cli [--solver cg|pcg|free|superlu|cholmod] [--reuse] [--multilevel]
+//            [--reorder] [--pins v0,v1] [--charts] [--chart-angle deg] [--chart-faces n]
+//            [--uv-only] [--metrics metrics.jsonl] [--telemetry telemetry.jsonl]
+//            [--tolerance t] [--min-change c] [--time-limit s] [--residuals residuals.jsonl]
+//            [--preview size] [--previous prev.obj] in.obj out.obj [in2.obj out2.obj ...]
+//   para_cli [options] (--batch dir | --manifest list.txt) [--memory mb] out_dir
+//   para_cli [--stream] [--memory mb] in.pmesh out.uv [in2.pmesh out2.uv ...]
+//
+// With --reuse, inputs sharing their connectivity (animation frames,
+// blendshapes) reuse pins and warm-start from the previous solution.
+// With --multilevel, the initial guess is solved on a coarsened mesh.
+// With --reorder, the system is assembled in a cache friendly vertex
+// order (see MeshOrdering), the outputs keep the input order.
+// With --pins, the two given vertices are pinned instead of the ends
+// of the boundary diameter (see PinSelection).
+// With --charts, the mesh is cut into charts packed into one atlas,
+// and the texcoords are written per face corner.
+// Inputs and outputs ending in .pmesh are binary meshes, which load
+// without parsing (see BinaryMesh). With --uv-only, the outputs are
+// UV sidecars that only hold the texcoords.
+// With --metrics, the distortion of every result is appended to a
+// JSON lines file, one line per input (see DistortionMetrics).
+// With --telemetry, the wall and CPU time, allocations and peak memory
+// of every stage (load, the solver stages, metrics, write) and the
+// counters of the solve are appended as JSON lines (see Telemetry).
+// --tolerance (relative residual, 1e-10 by default), --min-change
+// (RMS (u,v) change of an iteration relative to the pin distance) and
+// --time-limit (seconds of CG per solve, the result is kept) stop the
+// parallel CG backends early, see SolverProgress. With --residuals,
+// the residual and change of every iteration are appended as JSON
+// lines.
+// With --preview, every output gets two PNG thumbnails next to it,
+// out.mesh.png with the mesh under the checker of the viewer and
+// out.uv.png with the UV layout, rendered on the CPU (see
+// PreviewRenderer).
+// With --batch or --manifest, every mesh of a directory or of a list
+// (lines "in.obj [out.obj]") is written to out_dir, many meshes at
+// once (see BatchScheduler). --memory caps the estimated memory of
+// the meshes in flight. Failed inputs are reported at the end and do
+// not stop the batch. --reuse is ignored in batch mode. Batches solve
+// with pcg unless --solver is given. The OpenNL solvers (cg, superlu,
+// cholmod) share one context per process, with them every job runs
+// alone with all threads instead of waiting for the context.
+// With --previous, the inputs are new versions of the mesh of
+// prev.obj (a single chart result with vertex texcoords, such as an
+// earlier output): they keep its texcoords and only the faces around
+// the vertices that moved since are solved again (see
+// LSCMSolver::solve_region). It is ignored with --charts and in batch
+// mode.
+// With --stream, large .pmesh inputs are solved out of core (see
+// StreamingSolver): the system is kept in a memory mapped scratch file
+// next to the output, and the outputs are UV sidecars. --memory caps
+// the heap memory of the solver vectors, beyond it they are mapped as
+// well. Only the stopping criteria, --residuals and --telemetry apply.
+
+struct Options
+{
+  Options() : solver(LSCMSolver::SOLVER_CG), cache(NULL), multilevel(false),
+              reorder(false), charts(false), chart_angle(60.0f), chart_faces(0), uv_only(false),
+              metrics(NULL), telemetry(NULL), tolerance(1e-10), min_change(0.0),
+              time_limit(0.0), residuals(NULL), preview(0), previous(NULL), stream(false),
+              memory_mb(0.0), log_mutex(NULL) { pins[0] = pins[1] = -1; }
+
+  LSCMSolver::SolverType solver;
+  LSCMCache* cache;
+  bool multilevel;
+  bool reorder;
+  int pins[2];
+  bool charts;
+  float chart_angle;
+  int chart_faces;
+  bool uv_only;
+  std::ostream* metrics;
+  std::ostream* telemetry;
+  double tolerance;
+  double min_change;
+  double time_limit;
+  std::ostream* residuals;
+  int preview;
+  const char* previous;
+  bool stream;
+  double memory_mb;
+  std::mutex* log_mutex;
+};
+
+static bool parse_solver(const char* _name, LSCMSolver::SolverType& _type)
+{
+  if      (!strcmp(_name, "cg"))      _type = LSCMSolver::SOLVER_CG;
+  else if (!strcmp(_name, "pcg"))     _type = LSCMSolver::SOLVER_PARALLEL_CG;
+  else if (!strcmp(_name, "free"))    _type = LSCMSolver::SOLVER_MATRIX_FREE_CG;
+  else if (!strcmp(_name, "superlu")) _type = LSCMSolver::SOLVER_SUPERLU;
+  else if (!strcmp(_name, "cholmod")) _type = LSCMSolver::SOLVER_CHOLMOD;
+  else return false;
+  return true;
+}
+
+// The full mesh, or with --uv-only just the texcoords (see ObjWriter)
+static bool write_result(const Mesh& _mesh, const char* _out, OpenMesh::IO::Options _opt,
+                         const Options& _options)
+{
+  if (_options.uv_only)
+    return ObjWriter(_mesh).write_uv(_out, _opt);
+  return ObjWriter::write_mesh(_mesh, _out, _opt);
+}
+
+static std::string json_escape(const std::string& _s)
+{
+  std::string out;
+  for (size_t i = 0; i < _s.size(); ++i)
+  {
+    if (_s[i] == '"' || _s[i] == '\\')
+      out += '\\';
+    out += _s[i];
+  }
+  return out;
+}
+
+static void write_metrics(const Mesh& _mesh, const char* _in, bool _corners,
+                          const Options& _opt)
+{
+  if (!_opt.metrics)
+    return;
+  DistortionMetrics metrics(_mesh);
+  if (metrics.compute(_corners))
+  {
+    std::lock_guard<std::mutex> lock(*_opt.log_mutex);
+    *_opt.metrics << "{\"input\":\"" << json_escape(_in) << "\",\"metrics\":"
+                  << metrics.json() << "}" << std::endl;
+  }
+}
+
+static const char* stop_name(SolverProgress::Stop _stop)
+{
+  switch (_stop)
+  {
+  case SolverProgress::STOP_CHANGE:     return " (stalled)";
+  case SolverProgress::STOP_TIME:       return " (time limit)";
+  case SolverProgress::STOP_ITERATIONS: return " (iteration cap)";
+  default:                              return "";
+  }
+}
+
+// stopping criteria of the options, residuals streamed to --residuals
+static void setup_progress(SolverProgress& _progress, const char* _in, const Options& _opt)
+{
+  _progress.set_tolerance(_opt.tolerance);
+  _progress.set_min_change(_opt.min_change);
+  _progress.set_time_limit(_opt.time_limit);
+  if (!_opt.residuals)
+    return;
+  std::string input = json_escape(_in);
+  _progress.set_callback([input, &_opt](int _it, double _residual, double _change)
+  {
+    std::lock_guard<std::mutex> lock(*_opt.log_mutex);
+    *_opt.residuals << "{\"input\":\"" << input << "\",\"iteration\":" << _it
+                    << ",\"residual\":" << _residual << ",\"change\":" << _change << "}\n";
+  });
+}
+
+// out.obj --> out.mesh.png and out.uv.png
+static bool write_previews(const Mesh& _mesh, const char* _out, bool _corners,
+                           const Options& _opt)
+{
+  if (_opt.preview <= 0)
+    return true;
+  std::string stem = _out;
+  size_t dot = stem.find_last_of('.');
+  if (dot != std::string::npos && stem.find_first_of("/\\", dot) == std::string::npos)
+    stem.erase(dot);
+
+  PreviewRenderer renderer(_mesh);
+  renderer.set_corners(_corners);
+  std::vector<unsigned char> rgb;
+  const char* names[2] = { ".mesh.png", ".uv.png" };
+  for (int i = 0; i < 2; i++)
+  {
+    std::string name = stem + names[i];
+    bool ok = i == 0 ? renderer.render_mesh(_opt.preview, rgb) : renderer.render_uv(_opt.preview, rgb);
+    if (!ok || !PreviewRenderer::write_png(name.c_str(), _opt.preview, _opt.preview, rgb))
+    {
+      std::cerr << name << ": cannot write preview\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+static void write_telemetry(Telemetry& _telemetry, const char* _in, const Options& _opt)
+{
+  _telemetry.end();
+  if (!_opt.telemetry)
+    return;
+  std::lock_guard<std::mutex> lock(*_opt.log_mutex);
+  *_opt.telemetry << "{\"input\":\"" << json_escape(_in) << "\",\"telemetry\":"
+                  << _telemetry.json() << "}" << std::endl;
+}
+
+static bool parameterize_charts(Mesh& _mesh, const char* _in, const char* _out,
+                                const Options& _opt, Telemetry& _telemetry)
+{
+  SolverProgress progress;
+  setup_progress(progress, _in, _opt);
+
+  ChartAtlas atlas(_mesh);
+  atlas.set_progress(&progress);
+  atlas.set_max_angle(_opt.chart_angle);
+  atlas.set_max_faces(_opt.chart_faces);
+  atlas.set_multilevel(_opt.multilevel);
+  _telemetry.begin("atlas");
+  if (!atlas.solve())
+  {
+    std::cerr << _in << ": parameterization failed\n";
+    return false;
+  }
+  _telemetry.set_counter("charts", atlas.n_charts());
+  _telemetry.set_counter("iterations", atlas.used_iterations());
+  _telemetry.begin("metrics");
+  write_metrics(_mesh, _in, true, _opt);
+
+  _telemetry.begin("write");
+  OpenMesh::IO::Options opt = OpenMesh::IO::Options::FaceTexCoord;
+  if (!write_result(_mesh, _out, opt, _opt))
+  {
+    std::cerr << _out << ": cannot write mesh\n";
+    return false;
+  }
+  _telemetry.begin("preview");
+  if (!write_previews(_mesh, _out, true, _opt))
+    return false;
+
+  std::ostringstream line;
+  line << _in << ": "
+       << _mesh.n_vertices() << " vertices, "
+       << _mesh.n_faces() << " faces, "
+       << atlas.n_charts() << " charts, "
+       << atlas.used_iterations() << " iterations, "
+       << atlas.solver_time() << " s\n";
+  std::cout << line.str();
+  write_telemetry(_telemetry, _in, _opt);
+  return true;
+}
+
+static bool parameterize_streaming(const char* _in, const char* _out, const Options& _opt)
+{
+  Telemetry telemetry;
+  SolverProgress progress;
+  setup_progress(progress, _in, _opt);
+
+  StreamingSolver solver;
+  solver.set_memory_budget(_opt.memory_mb);
+  solver.set_progress(&progress);
+  solver.set_telemetry(&telemetry);
+  if (!solver.solve(_in, _out))
+  {
+    std::cerr << _in << ": parameterization failed\n";
+    return false;
+  }
+
+  std::ostringstream line;
+  line << _in << ": "
+       << solver.n_vertices() << " vertices, "
+       << solver.n_faces() << " faces, "
+       << solver.used_iterations() << " iterations, "
+       << solver.solver_time() << " s"
+       << (solver.vectors_mapped() ? " (mapped)" : "")
+       << stop_name(progress.stop()) << "\n";
+  std::cout << line.str();
+  write_telemetry(telemetry, _in, _opt);
+  return true;
+}
+
+// Texcoords of --previous copied to _mesh, and the faces around the
+// vertices that moved since in _changed
+static bool load_previous(Mesh& _mesh, const char* _in, const Options& _opt,
+                          std::vector<int>& _changed)
+{
+  Mesh previous;
+  previous.request_vertex_texcoords2D();
+  bool ok = BinaryMesh::is_binary(_opt.previous) ?
+    BinaryMesh::read_mesh(previous, _opt.previous) :
+    OpenMesh::IO::read_mesh(previous, _opt.previous, OpenMesh::IO::Options::VertexTexCoord);
+  if (!ok)
+  {
+    std::cerr << _opt.previous << ": cannot read mesh\n";
+    return false;
+  }
+  if (previous.n_vertices() != _mesh.n_vertices() || previous.n_faces() != _mesh.n_faces())
+  {
+    std::cerr << _in << ": not a version of " << _opt.previous << "\n";
+    return false;
+  }
+
+  int nb_vertices = _mesh.n_vertices();
+  std::vector<unsigned char> moved(nb_vertices);
+  for (int i = 0; i < nb_vertices; ++i)
+  {
+    Mesh::VertexHandle vh(i);
+    moved[i] = _mesh.point(vh) != previous.point(vh);
+    _mesh.set_texcoord2D(vh, previous.texcoord2D(vh));
+  }
+
+  _changed.clear();
+  for (Mesh::FaceIter f = _mesh.faces_begin(); f != _mesh.faces_end(); ++f)
+  {
+    for (Mesh::FaceVertexIter fv = _mesh.fv_iter(*f); fv.is_valid(); ++fv)
+    {
+      if (moved[(*fv).idx()])
+      {
+        _changed.push_back((*f).idx());
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+static bool parameterize(const char* _in, const char* _out, const Options& _opt)
+{
+  if (_opt.stream)
+    return parameterize_streaming(_in, _out, _opt);
+
+  Mesh mesh;
+  mesh.request_vertex_texcoords2D();
+
+  Telemetry telemetry;
+  telemetry.begin("load");
+  if (!BinaryMesh::read_mesh(mesh, _in))
+  {
+    std::cerr << _in << ": cannot read mesh\n";
+    return false;
+  }
+
+  telemetry.end();
+
+  if (_opt.charts)
+    return parameterize_charts(mesh, _in, _out, _opt, telemetry);
+
+  std::vector<int> changed;
+  if (_opt.previous)
+  {
+    telemetry.begin("load_previous");
+    if (!load_previous(mesh, _in, _opt, changed))
+      return false;
+    telemetry.end();
+  }
+
+  LSCMSolver solver(mesh);
+  solver.set_solver(_opt.solver);
+  solver.set_cache(_opt.cache);
+  solver.set_multilevel(_opt.multilevel);
+  solver.set_reorder(_opt.reorder);
+  solver.set_pins(_opt.pins[0], _opt.pins[1]);
+  solver.set_telemetry(&telemetry);
+  SolverProgress progress;
+  setup_progress(progress, _in, _opt);
+  solver.set_progress(&progress);
+  if (!(_opt.previous ? solver.solve_region(changed) : solver.solve()))
+  {
+    std::cerr << _in << ": parameterization failed\n";
+    return false;
+  }
+  telemetry.begin("metrics");
+  write_metrics(mesh, _in, false, _opt);
+
+  telemetry.begin("write");
+  OpenMesh::IO::Options opt = OpenMesh::IO::Options::VertexTexCoord;
+  if (!write_result(mesh, _out, opt, _opt))
+  {
+    std::cerr << _out << ": cannot write mesh\n";
+    return false;
+  }
+  telemetry.begin("preview");
+  if (!write_previews(mesh, _out, false, _opt))
+    return false;
+
+  // one write per line, batch jobs report from several threads
+  std::ostringstream line;
+  line << _in << ": "
+       << mesh.n_vertices() << " vertices, "
+       << mesh.n_faces() << " faces, ";
+  if (_opt.previous)
+    line << changed.size() << " changed, ";
+  line << solver.used_iterations() << " iterations, "
+       << solver.solver_time() << " s"
+       << (solver.used_cache() ? " (cached)" : "")
+       << stop_name(progress.stop()) << "\n";
+  std::cout << line.str();
+  write_telemetry(telemetry, _in, _opt);
+  return true;
+}
+
+
+static int usage(const char* _prog)
+{
+  std::cerr << "usage: " << _prog
+            << " [--solver cg|pcg|free|superlu|cholmod] [--reuse] [--multilevel]\n"
+            << "       [--reorder] [--pins v0,v1] [--charts] [--chart-angle deg] [--chart-faces n]\n"
+            << "       [--uv-only] [--metrics metrics.jsonl] [--telemetry telemetry.jsonl]\n"
+            << "       [--tolerance t] [--min-change c] [--time-limit s] [--residuals residuals.jsonl]\n"
+            << "       [--preview size] [--previous prev.obj]\n"
+            << "       in.obj out.obj [in2.obj out2.obj ...]\n"
+            << "       " << _prog << " [options] (--batch dir | --manifest list.txt) [--memory mb] out_dir\n"
+            << "       " << _prog << " [--stream] [--memory mb] in.pmesh out.uv [in2.pmesh out2.uv ...]\n";
+  return 1;
+}
+
+static int run_batch(BatchScheduler& _batch, const Options& _opt)
+{
+  int failed = _batch.run([&_opt](const BatchScheduler::Job& _job)
+  {
+    return parameterize(_job.input.c_str(), _job.output.c_str(), _opt);
+  });
+
+  const std::vector<BatchScheduler::Job>& jobs = _batch.jobs();
+  for (size_t k = 0; k < jobs.size(); ++k)
+  {
+    if (!jobs[k].ok)
+      std::cerr << "failed: " << jobs[k].input << "\n";
+  }
+  std::cout << jobs.size() << " meshes, " << failed << " failed, "
+            << _batch.time() << " s\n";
+  return failed ? 2 : 0;
+}
+
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  LSCMCache cache;
+  std::ofstream metrics, telemetry, residuals;
+  std::mutex log_mutex;
+  opt.log_mutex = &log_mutex;
+  BatchScheduler batch;
+  std::string batch_dir, manifest;
+  bool solver_set = false;
+
+  int i = 1;
+  for (; i < argc && !strncmp(argv[i], "--", 2); ++i)
+  {
+    if (!strcmp(argv[i], "--solver") && i + 1 < argc)
+    {
+      if (!parse_solver(argv[++i], opt.solver))
+        return usage(argv[0]);
+      solver_set = true;
+    }
+    else if (!strcmp(argv[i], "--reuse"))
+      opt.cache = &cache;
+    else if (!strcmp(argv[i], "--multilevel"))
+      opt.multilevel = true;
+    else if (!strcmp(argv[i], "--reorder"))
+      opt.reorder = true;
+    else if (!strcmp(argv[i], "--pins") && i + 1 < argc)
+    {
+      if (sscanf(argv[++i], "%d,%d", &opt.pins[0], &opt.pins[1]) != 2)
+        return usage(argv[0]);
+    }
+    else if (!strcmp(argv[i], "--charts"))
+      opt.charts = true;
+    else if (!strcmp(argv[i], "--chart-angle") && i + 1 < argc)
+      opt.chart_angle = (float)atof(argv[++i]);
+    else if (!strcmp(argv[i], "--chart-faces") && i + 1 < argc)
+      opt.chart_faces = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--uv-only"))
+      opt.uv_only = true;
+    else if (!strcmp(argv[i], "--metrics") && i + 1 < argc)
+    {
+      metrics.open(argv[++i], std::ios::app);
+      if (!metrics)
+      {
+        std::cerr << argv[i] << ": cannot write file\n";
+        return 1;
+      }
+      opt.metrics = &metrics;
+    }
+    else if (!strcmp(argv[i], "--telemetry") && i + 1 < argc)
+    {
+      telemetry.open(argv[++i], std::ios::app);
+      if (!telemetry)
+      {
+        std::cerr << argv[i] << ": cannot write file\n";
+        return 1;
+      }
+      opt.telemetry = &telemetry;
+    }
+    else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+      opt.tolerance = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--min-change") && i + 1 < argc)
+      opt.min_change = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--time-limit") && i + 1 < argc)
+      opt.time_limit = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--preview") && i + 1 < argc)
+      opt.preview = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--residuals") && i + 1 < argc)
+    {
+      residuals.open(argv[++i], std::ios::app);
+      if (!residuals)
+      {
+        std::cerr << argv[i] << ": cannot write file\n";
+        return 1;
+      }
+      opt.residuals = &residuals;
+    }
+    else if (!strcmp(argv[i], "--batch") && i + 1 < argc)
+      batch_dir = argv[++i];
+    else if (!strcmp(argv[i], "--manifest") && i + 1 < argc)
+      manifest = argv[++i];
+    else if (!strcmp(argv[i], "--memory") && i + 1 < argc)
+    {
+      opt.memory_mb = atof(argv[++i]);
+      batch.set_memory_budget(opt.memory_mb);
+    }
+    else if (!strcmp(argv[i], "--previous") && i + 1 < argc)
+      opt.previous = argv[++i];
+    else if (!strcmp(argv[i], "--stream"))
+      opt.stream = true;
+    else
+      return usage(argv[0]);
+  }
+
+  if (!batch_dir.empty() || !manifest.empty())
+  {
+    if (argc - i != 1)
+      return usage(argv[0]);
+    if (!batch_dir.empty() && !batch.add_directory(batch_dir, argv[i]))
+      return 1;
+    if (!manifest.empty() && !batch.add_manifest(manifest, argv[i]))
+      return 1;
+    // the cache is not shared between threads
+    opt.cache = NULL;
+    opt.previous = NULL;
+    // OpenNL solves take turns on one context, concurrent jobs would
+    // only hold their threads while waiting for it
+    if (!solver_set)
+      opt.solver = LSCMSolver::SOLVER_PARALLEL_CG;
+    else if (opt.solver == LSCMSolver::SOLVER_CG || opt.solver == LSCMSolver::SOLVER_SUPERLU ||
+             opt.solver == LSCMSolver::SOLVER_CHOLMOD)
+      batch.set_big_job(0);
+    return run_batch(batch, opt);
+  }
+
+  if (argc - i < 2 || (argc - i) % 2 != 0)
+    return usage(argv[0]);
+
+  int failed = 0;
+  for (; i + 1 < argc; i += 2)
+  {
+    if (!parameterize(argv[i], argv[i + 1], opt))
+      ++failed;
+  }
+
+  return failed ? 2 : 0;
+}
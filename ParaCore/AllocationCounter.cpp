@@ -0,0 +1,78 @@
+#include "Telemetry.h"
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new and delete to count allocations for
+// Telemetry. Not part of ParaCore: only the programs that report
+// allocations (para_cli, para_bench) compile it, the viewer keeps the
+// default operators. Every usual form is replaced so that news and
+// deletes always pair up, the sized deletes are those of C++14.
+
+static void* allocate(size_t _size)
+{
+	Telemetry::count_allocation();
+	return malloc(_size ? _size : 1);
+}
+
+// turns the allocations on in the reports of the program
+static struct AllocationCounter
+{
+	AllocationCounter() { Telemetry::enable_allocation_count(); }
+} allocation_counter;
+
+
+void* operator new(size_t _size)
+{
+	void* p = allocate(_size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t _size)
+{
+	void* p = allocate(_size);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t _size, const std::nothrow_t&) throw()
+{
+	return allocate(_size);
+}
+
+void* operator new[](size_t _size, const std::nothrow_t&) throw()
+{
+	return allocate(_size);
+}
+
+void operator delete(void* _p) throw()
+{
+	free(_p);
+}
+
+void operator delete[](void* _p) throw()
+{
+	free(_p);
+}
+
+void operator delete(void* _p, const std::nothrow_t&) throw()
+{
+	free(_p);
+}
+
+void operator delete[](void* _p, const std::nothrow_t&) throw()
+{
+	free(_p);
+}
+
+void operator delete(void* _p, size_t) throw()
+{
+	free(_p);
+}
+
+void operator delete[](void* _p, size_t) throw()
+{
+	free(_p);
+}
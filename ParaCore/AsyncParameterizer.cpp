@@ -0,0 +1,174 @@
+#include "AsyncParameterizer.h"
+#include "LSCMSolver.h"
+#include "ChartAtlas.h"
+#include <memory>
+
+
+AsyncParameterizer::AsyncParameterizer() :
+running_(false), mode_(MODE_LSCM), key_(0), ready_(false)
+{
+}
+
+AsyncParameterizer::~AsyncParameterizer()
+{
+	cancel();
+}
+
+void AsyncParameterizer::start(const Mesh& _mesh, Mode _mode,
+	const std::vector<unsigned int>* _indices)
+{
+	launch(_mesh, _mode, _indices, NULL);
+}
+
+void AsyncParameterizer::start_region(const Mesh& _mesh, const std::vector<int>& _faces,
+	const std::vector<unsigned int>* _indices)
+{
+	launch(_mesh, MODE_LSCM, _indices, &_faces);
+}
+
+void AsyncParameterizer::launch(const Mesh& _mesh, Mode _mode,
+	const std::vector<unsigned int>* _indices, const std::vector<int>* _region)
+{
+	cancel();
+
+	if (_indices)
+		indices_ = *_indices;
+	else
+		indices_.clear();
+	if (_region)
+		region_ = *_region;
+	else
+		region_.clear();
+	key_ = connectivity_key(_mesh);
+
+	progress_.reset();
+	mode_ = _mode;
+	running_ = true;
+
+	// the copy is owned by the worker from now on
+	thread_ = std::thread(&AsyncParameterizer::run, this, new Mesh(_mesh), _mode);
+}
+
+void AsyncParameterizer::cancel()
+{
+	progress_.cancel();
+	join();
+
+	// a result published just before the cancel is dropped as well
+	std::lock_guard<std::mutex> lock(mutex_);
+	ready_ = false;
+	result_ = Result();
+}
+
+void AsyncParameterizer::join()
+{
+	if (thread_.joinable())
+		thread_.join();
+}
+
+bool AsyncParameterizer::apply_result(Mesh& _mesh)
+{
+	Result result;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!ready_)
+			return false;
+		std::swap(result, result_);
+		ready_ = false;
+	}
+	join();
+
+	if (result.key != connectivity_key(_mesh) || result.vertex_tc.size() != _mesh.n_vertices() ||
+		(!result.halfedge_tc.empty() && result.halfedge_tc.size() != _mesh.n_halfedges()))
+		return false;
+
+	_mesh.request_vertex_texcoords2D();
+	for (size_t i = 0; i < result.vertex_tc.size(); i++)
+		_mesh.set_texcoord2D(Mesh::VertexHandle((int)i), result.vertex_tc[i]);
+
+	if (!result.halfedge_tc.empty())
+	{
+		_mesh.request_halfedge_texcoords2D();
+		for (size_t i = 0; i < result.halfedge_tc.size(); i++)
+			_mesh.set_texcoord2D(Mesh::HalfedgeHandle((int)i), result.halfedge_tc[i]);
+	}
+
+	applied_ = result;
+	applied_.vertex_tc.clear();
+	applied_.halfedge_tc.clear();
+	return true;
+}
+
+// FNV-1a, like the key of LSCMCache
+unsigned long long AsyncParameterizer::connectivity_key(const Mesh& _mesh)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	h = (h ^ (unsigned)_mesh.n_vertices()) * 1099511628211ULL;
+	int nb_halfedges = (int)_mesh.n_halfedges();
+	for (int i = 0; i < nb_halfedges; i++)
+		h = (h ^ (unsigned)_mesh.to_vertex_handle(Mesh::HalfedgeHandle(i)).idx()) * 1099511628211ULL;
+	return h;
+}
+
+void AsyncParameterizer::run(Mesh* _mesh, Mode _mode)
+{
+	std::unique_ptr<Mesh> mesh(_mesh);
+	Result result;
+	result.mode = _mode;
+	result.key = key_;
+	bool ok = false;
+
+	if (_mode == MODE_ATLAS)
+	{
+		ChartAtlas atlas(*mesh);
+		atlas.set_progress(&progress_);
+		result.telemetry.begin("atlas");
+		ok = atlas.solve();
+		result.telemetry.end();
+		result.time = atlas.solver_time();
+		result.iterations = atlas.used_iterations();
+		result.charts = atlas.n_charts();
+		result.telemetry.set_counter("charts", result.charts);
+		result.telemetry.set_counter("iterations", result.iterations);
+
+		if (ok)
+		{
+			result.halfedge_tc.resize(mesh->n_halfedges());
+			for (size_t i = 0; i < result.halfedge_tc.size(); i++)
+				result.halfedge_tc[i] = mesh->texcoord2D(Mesh::HalfedgeHandle((int)i));
+		}
+	}
+	else
+	{
+		LSCMSolver solver(*mesh);
+		solver.set_solver(LSCMSolver::SOLVER_PARALLEL_CG);
+		solver.set_faces(&indices_);
+		solver.set_progress(&progress_);
+		solver.set_telemetry(&result.telemetry);
+		solver.set_write_mesh(false);
+		ok = region_.empty() ? solver.solve() : solver.solve_region(region_);
+		result.time = solver.solver_time();
+		result.iterations = solver.used_iterations();
+		result.charts = 1;
+		// a region solve merges into the texcoords of the mesh instead
+		if (ok && solver.texcoords().size() == mesh->n_vertices())
+			result.vertex_tc = solver.texcoords();
+	}
+
+	if (ok)
+	{
+		// the atlas and region solves only write to the mesh
+		if (result.vertex_tc.empty())
+		{
+			result.vertex_tc.resize(mesh->n_vertices());
+			for (size_t i = 0; i < result.vertex_tc.size(); i++)
+				result.vertex_tc[i] = mesh->texcoord2D(Mesh::VertexHandle((int)i));
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::swap(result_, result);
+		ready_ = true;
+	}
+
+	running_ = false;
+}
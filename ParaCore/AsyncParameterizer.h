@@ -0,0 +1,98 @@
+#pragma once
+#include "MeshTypes.h"
+#include "SolverProgress.h"
+#include "Telemetry.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Runs a parameterization on a worker thread. The worker solves a
+/// private copy of the mesh, so the owner keeps rendering its own one,
+/// and a finished result is handed over in one piece: the owner picks
+/// it up from its own thread with apply_result().
+class AsyncParameterizer
+{
+public:
+	enum Mode
+	{
+		MODE_LSCM,  ///< single chart LSCMSolver, parallel CG backend
+		MODE_ATLAS  ///< ChartAtlas, texcoords per halfedge
+	};
+
+public:
+	AsyncParameterizer();
+	/// cancels and waits for a running job
+	~AsyncParameterizer();
+
+	/// parameterize a snapshot of _mesh, a running job is cancelled
+	/// first. _indices are its faces as a flat triangle list, if known
+	/// (see LSCMSolver::set_faces).
+	void start(const Mesh& _mesh, Mode _mode, const std::vector<unsigned int>* _indices = NULL);
+	/// Re-solve only around _faces (see LSCMSolver::solve_region) on a
+	/// snapshot of _mesh, whose vertex texcoords hold a single chart
+	/// result. Runs in MODE_LSCM and is picked up like start()'s.
+	void start_region(const Mesh& _mesh, const std::vector<int>& _faces,
+		const std::vector<unsigned int>* _indices = NULL);
+	/// cancel the running job and wait for it, its result is dropped
+	void cancel();
+
+	bool running() const { return running_; }
+	Mode mode() const { return mode_; }
+	const SolverProgress& progress() const { return progress_; }
+
+	/// If a finished result is pending, write its texcoords to _mesh and
+	/// return true. _mesh must still have the connectivity of the
+	/// snapshot (same connectivity_key()), otherwise the result is
+	/// dropped.
+	bool apply_result(Mesh& _mesh);
+
+	/// statistics of the last applied result
+	double solver_time() const { return applied_.time; }
+	int used_iterations() const { return applied_.iterations; }
+	int n_charts() const { return applied_.charts; }
+	/// stages and counters of the solve of the last applied result
+	const Telemetry& telemetry() const { return applied_.telemetry; }
+
+	/// hash of the vertex count and of the target vertex of every
+	/// halfedge, equal for meshes whose texcoords fit each other
+	static unsigned long long connectivity_key(const Mesh& _mesh);
+
+private:
+	struct Result
+	{
+		Result() : mode(MODE_LSCM), key(0), time(0.0), iterations(0), charts(0) {}
+
+		Mode mode;
+		unsigned long long key;  ///< connectivity_key() of the snapshot
+		std::vector<Vec2f> vertex_tc;
+		std::vector<Vec2f> halfedge_tc;
+		double time;
+		int iterations;
+		int charts;
+		Telemetry telemetry;
+	};
+
+	void launch(const Mesh& _mesh, Mode _mode, const std::vector<unsigned int>* _indices,
+		const std::vector<int>* _region);
+	void join();
+	void run(Mesh* _mesh, Mode _mode);
+
+private:
+	std::thread thread_;
+	std::atomic<bool> running_;
+	Mode mode_;
+	SolverProgress progress_;
+	// snapshot of the face indices and of the faces of a region solve,
+	// read by the worker only
+	std::vector<unsigned int> indices_;
+	std::vector<int> region_;
+	unsigned long long key_;
+
+	// written by the worker, taken by the owner
+	std::mutex mutex_;
+	bool ready_;
+	Result result_;
+
+	Result applied_;
+};
@@ -0,0 +1,225 @@
+#include "BatchScheduler.h"
+#include "BinaryMesh.h"
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <omp.h>
+
+#if defined(_WIN32)
+#  define NOMINMAX
+#  include <windows.h>
+#else
+#  include <dirent.h>
+#endif
+
+// OBJ text per face (its vertex and face lines), and peak memory of
+// the pipeline per face: halfedge mesh, face list, system and CG vectors
+static const int OBJ_BYTES_PER_FACE = 30;
+static const int BYTES_PER_FACE = 400;
+
+
+BatchScheduler::BatchScheduler() :
+memory_budget_(0.0), big_job_(20000), time_(0.0), memory_used_(0.0)
+{
+}
+
+static std::string file_name(const std::string& _path)
+{
+	size_t slash = _path.find_last_of("/\\");
+	return slash == std::string::npos ? _path : _path.substr(slash + 1);
+}
+
+static std::string join(const std::string& _dir, const std::string& _name)
+{
+	if (_dir.empty())
+		return _name;
+	char last = _dir[_dir.size() - 1];
+	return last == '/' || last == '\\' ? _dir + _name : _dir + "/" + _name;
+}
+
+static bool is_mesh(const std::string& _name)
+{
+	size_t dot = _name.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string ext = _name.substr(dot + 1);
+	for (size_t i = 0; i < ext.size(); i++)
+		ext[i] = (char)tolower((unsigned char)ext[i]);
+	return ext == "obj" || ext == "pmesh";
+}
+
+void BatchScheduler::add(const std::string& _input, const std::string& _output)
+{
+	Job job;
+	job.input = _input;
+	job.output = _output;
+	job.faces = 0;
+	job.memory_mb = 0.0;
+	job.ok = false;
+	job.time = 0.0;
+	jobs_.push_back(job);
+}
+
+bool BatchScheduler::add_directory(const std::string& _dir, const std::string& _out_dir)
+{
+	std::vector<std::string> names;
+#if defined(_WIN32)
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA(join(_dir, "*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << _dir << ": cannot read directory\n";
+		return false;
+	}
+	do
+	{
+		if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			names.push_back(data.cFileName);
+	} while (FindNextFileA(find, &data));
+	FindClose(find);
+#else
+	DIR* dir = opendir(_dir.c_str());
+	if (!dir)
+	{
+		std::cerr << _dir << ": cannot read directory\n";
+		return false;
+	}
+	while (struct dirent* entry = readdir(dir))
+		names.push_back(entry->d_name);
+	closedir(dir);
+#endif
+
+	// listing order differs between systems
+	std::sort(names.begin(), names.end());
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (is_mesh(names[i]))
+			add(join(_dir, names[i]), join(_out_dir, names[i]));
+	}
+	return true;
+}
+
+bool BatchScheduler::add_manifest(const std::string& _filename, const std::string& _out_dir)
+{
+	std::ifstream in(_filename.c_str());
+	if (!in)
+	{
+		std::cerr << _filename << ": cannot read manifest\n";
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(in, line))
+	{
+		std::istringstream fields(line);
+		std::string input, output;
+		if (!(fields >> input) || input[0] == '#')
+			continue;
+		if (!(fields >> output))
+			output = join(_out_dir, file_name(input));
+		add(input, output);
+	}
+	return true;
+}
+
+// .pmesh headers hold the face count, OBJ files are only measured
+void BatchScheduler::estimate(Job& _job) const
+{
+	double faces = 0.0;
+	if (BinaryMesh::is_binary(_job.input))
+	{
+		BinaryMesh file;
+		if (file.open(_job.input.c_str()))
+			faces = file.n_faces();
+	}
+	else
+	{
+		std::ifstream in(_job.input.c_str(), std::ios::binary | std::ios::ate);
+		if (in)
+			faces = (double)in.tellg() / OBJ_BYTES_PER_FACE;
+	}
+	_job.faces = (int)std::min(faces, 2.0e9);
+	_job.memory_mb = faces * BYTES_PER_FACE / (1024.0 * 1024.0);
+}
+
+void BatchScheduler::acquire(double _mb)
+{
+	if (memory_budget_ <= 0.0)
+		return;
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (memory_used_ > 0.0 && memory_used_ + _mb > memory_budget_)
+		released_.wait(lock);
+	memory_used_ += _mb;
+}
+
+void BatchScheduler::release(double _mb)
+{
+	if (memory_budget_ <= 0.0)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		memory_used_ = std::max(0.0, memory_used_ - _mb);
+	}
+	released_.notify_all();
+}
+
+// exceptions must not leave an OpenMP region, and a job running out
+// of memory must not end the batch
+void BatchScheduler::run_job(Job& _job, const Function& _f)
+{
+	acquire(_job.memory_mb);
+	double t0 = omp_get_wtime();
+	try
+	{
+		_job.ok = _f(_job);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << _job.input << ": " << e.what() << "\n";
+		_job.ok = false;
+	}
+	catch (...)
+	{
+		std::cerr << _job.input << ": failed\n";
+		_job.ok = false;
+	}
+	_job.time = omp_get_wtime() - t0;
+	release(_job.memory_mb);
+}
+
+int BatchScheduler::run(const Function& _f)
+{
+	double t0 = omp_get_wtime();
+	int nb_jobs = (int)jobs_.size();
+	for (int i = 0; i < nb_jobs; i++)
+		estimate(jobs_[i]);
+
+	// largest first, so that the last ones to finish are small
+	std::vector<int> order(nb_jobs);
+	for (int i = 0; i < nb_jobs; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [this](int a, int b)
+	{
+		return jobs_[a].faces > jobs_[b].faces;
+	});
+
+	int first_small = 0;
+	while (first_small < nb_jobs && jobs_[order[first_small]].faces >= big_job_)
+		run_job(jobs_[order[first_small++]], _f);
+
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = first_small; i < nb_jobs; i++)
+		run_job(jobs_[order[i]], _f);
+	time_ = omp_get_wtime() - t0;
+
+	int failed = 0;
+	for (int i = 0; i < nb_jobs; i++)
+	{
+		if (!jobs_[i].ok)
+			failed++;
+	}
+	return failed;
+}
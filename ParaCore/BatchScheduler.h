@@ -0,0 +1,75 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Runs one job (load, solve, write) per mesh over a whole directory
+/// or manifest. Like the charts of ChartAtlas, large meshes run one at
+/// a time with all threads inside their solve, the small ones are
+/// packed one per thread, largest first, each thread taking the next
+/// job as soon as it is done. Jobs only start while their estimated
+/// memory fits in the budget. A failed or throwing job is recorded and
+/// the batch goes on.
+class BatchScheduler
+{
+public:
+	struct Job
+	{
+		std::string input;
+		std::string output;
+		int faces;         ///< estimated from the file
+		double memory_mb;  ///< estimated peak of the job
+		bool ok;
+		double time;
+	};
+
+	/// load, solve and write _job, false on failure. Called from
+	/// several threads at once for small jobs.
+	typedef std::function<bool(const Job& _job)> Function;
+
+public:
+	BatchScheduler();
+
+	/// _output is written from _input
+	void add(const std::string& _input, const std::string& _output);
+	/// every .obj and .pmesh file of _dir, written to _out_dir under
+	/// the same name
+	bool add_directory(const std::string& _dir, const std::string& _out_dir);
+	/// one input per line, optionally followed by its output (else it
+	/// goes to _out_dir under the same name). Empty lines and lines
+	/// starting with # are skipped.
+	bool add_manifest(const std::string& _filename, const std::string& _out_dir);
+
+	/// estimated memory of the jobs running at once (0: unlimited),
+	/// a single job over the budget still runs, alone
+	void set_memory_budget(double _mb) { memory_budget_ = _mb; }
+	double memory_budget() const { return memory_budget_; }
+
+	/// jobs of at least this many faces run alone with all threads
+	void set_big_job(int _faces) { big_job_ = _faces; }
+
+	/// run every job, returns the number of failed jobs
+	int run(const Function& _f);
+
+	const std::vector<Job>& jobs() const { return jobs_; }
+	double time() const { return time_; }
+
+private:
+	void estimate(Job& _job) const;
+	void run_job(Job& _job, const Function& _f);
+	void acquire(double _mb);
+	void release(double _mb);
+
+private:
+	std::vector<Job> jobs_;
+	double memory_budget_;
+	int big_job_;
+	double time_;
+
+	// estimated memory of the running jobs
+	std::mutex mutex_;
+	std::condition_variable released_;
+	double memory_used_;
+};
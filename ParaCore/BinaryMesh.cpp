@@ -0,0 +1,289 @@
+#include "BinaryMesh.h"
+#include "ObjReader.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+static const char MAGIC[4] = { 'P', 'M', 'S', 'H' };
+static const unsigned int VERSION = 1;
+// sections start on cache lines, and on SIMD loads
+static const size_t ALIGNMENT = 64;
+
+static size_t align(size_t _offset)
+{
+	return (_offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+
+BinaryMesh::BinaryMesh() :
+header_(NULL)
+{
+}
+
+size_t BinaryMesh::section_size(Section _s, size_t _n_vertices, size_t _n_faces)
+{
+	switch (_s)
+	{
+	case POSITIONS:        return _n_vertices * sizeof(Mesh::Point);
+	case INDICES:          return 3 * _n_faces * sizeof(unsigned int);
+	case NORMALS:          return _n_vertices * sizeof(Mesh::Normal);
+	case TEXCOORDS:        return _n_vertices * sizeof(Mesh::TexCoord2D);
+	case CORNER_TEXCOORDS: return 3 * _n_faces * sizeof(Mesh::TexCoord2D);
+	default:               return 0;
+	}
+}
+
+// FNV-1a over 32 bit words, every section is a multiple of 4 bytes
+unsigned long long BinaryMesh::hash_words(unsigned long long _h, const void* _data, size_t _bytes)
+{
+	const unsigned int* w = (const unsigned int*)_data;
+	for (size_t i = 0; i < _bytes / 4; i++)
+		_h = (_h ^ w[i]) * 1099511628211ULL;
+	return _h;
+}
+
+const char* BinaryMesh::section(Section _s) const
+{
+	if (!header_ || !header_->offset[_s])
+		return NULL;
+	return file_.data() + header_->offset[_s];
+}
+
+Mesh::Point BinaryMesh::bb_min() const
+{
+	if (!header_)
+		return Mesh::Point(0.0f, 0.0f, 0.0f);
+	return Mesh::Point(header_->bb_min[0], header_->bb_min[1], header_->bb_min[2]);
+}
+
+Mesh::Point BinaryMesh::bb_max() const
+{
+	if (!header_)
+		return Mesh::Point(0.0f, 0.0f, 0.0f);
+	return Mesh::Point(header_->bb_max[0], header_->bb_max[1], header_->bb_max[2]);
+}
+
+bool BinaryMesh::open(const char* _filename)
+{
+	close();
+	if (!file_.open(_filename))
+	{
+		std::cerr << _filename << ": cannot open file\n";
+		return false;
+	}
+
+	const Header* h = (const Header*)file_.data();
+	bool ok = file_.size() >= sizeof(Header) && !memcmp(h->magic, MAGIC, 4) &&
+		h->version == VERSION && h->offset[POSITIONS] && h->offset[INDICES];
+	for (int s = 0; ok && s < N_SECTIONS; s++)
+	{
+		size_t size = section_size((Section)s, h->n_vertices, h->n_faces);
+		unsigned long long offset = h->offset[s];
+		ok = offset == 0 || (offset % ALIGNMENT == 0 && offset >= sizeof(Header) &&
+			offset <= file_.size() && size <= file_.size() - offset);
+	}
+	if (!ok)
+	{
+		std::cerr << _filename << ": not a valid binary mesh\n";
+		file_.close();
+		return false;
+	}
+
+	header_ = h;
+	return true;
+}
+
+void BinaryMesh::close()
+{
+	header_ = NULL;
+	file_.close();
+}
+
+bool BinaryMesh::verify() const
+{
+	if (!header_)
+		return false;
+	unsigned long long h = 14695981039346656037ULL;
+	for (int s = 0; s < N_SECTIONS; s++)
+	{
+		if (has((Section)s))
+			h = hash_words(h, section((Section)s), section_size((Section)s, n_vertices(), n_faces()));
+	}
+	return h == header_->hash;
+}
+
+int BinaryMesh::build_mesh(Mesh& _mesh) const
+{
+	int nv = n_vertices();
+	int nf = n_faces();
+	const unsigned int* id = indices();
+	if (!id)
+		return -1;
+	for (int i = 0; i < 3 * nf; i++)
+	{
+		if (id[i] >= (unsigned int)nv)
+			return -1;
+	}
+
+	_mesh.clear();
+	_mesh.reserve(nv, 3 * nf / 2 + nv, nf);
+
+	const Mesh::Point* p = points();
+	std::vector<Mesh::VertexHandle> vh(nv);
+	for (int i = 0; i < nv; i++)
+		vh[i] = _mesh.add_vertex(p[i]);
+
+	const Mesh::Normal* n = _mesh.has_vertex_normals() ? normals() : NULL;
+	const Mesh::TexCoord2D* t = _mesh.has_vertex_texcoords2D() ? texcoords() : NULL;
+	for (int i = 0; i < nv && (n || t); i++)
+	{
+		if (n)
+			_mesh.set_normal(vh[i], n[i]);
+		if (t)
+			_mesh.set_texcoord2D(vh[i], t[i]);
+	}
+
+	// add_face() starts the face loop at its first vertex, so the
+	// corners come back in the order they were written
+	const Mesh::TexCoord2D* c = _mesh.has_halfedge_texcoords2D() ? corner_texcoords() : NULL;
+	int added = 0;
+	for (int f = 0; f < nf; f++, id += 3)
+	{
+		if (id[0] == id[1] || id[1] == id[2] || id[2] == id[0])
+			continue;
+		Mesh::FaceHandle fh = _mesh.add_face(vh[id[0]], vh[id[1]], vh[id[2]]);
+		if (!fh.is_valid())
+			continue;
+		if (c)
+		{
+			int k = 0;
+			for (auto fh_it = _mesh.fh_iter(fh); fh_it.is_valid(); ++fh_it)
+				_mesh.set_texcoord2D(*fh_it, c[3 * f + k++]);
+		}
+		added++;
+	}
+	return added;
+}
+
+bool BinaryMesh::write(const Mesh& _mesh, const char* _filename, OpenMesh::IO::Options _opt)
+{
+	size_t nv = _mesh.n_vertices();
+	size_t nf = _mesh.n_faces();
+
+	std::vector<unsigned int> indices;
+	indices.reserve(3 * nf);
+	std::vector<Mesh::TexCoord2D> corners;
+	bool write_corners = _opt.check(OpenMesh::IO::Options::FaceTexCoord) &&
+		_mesh.has_halfedge_texcoords2D();
+	if (write_corners)
+		corners.reserve(3 * nf);
+
+	Mesh::ConstFaceIter f_it, f_end(_mesh.faces_end());
+	for (f_it = _mesh.faces_begin(); f_it != f_end; ++f_it)
+	{
+		for (auto fh_it = _mesh.cfh_iter(*f_it); fh_it.is_valid(); ++fh_it)
+		{
+			indices.push_back(_mesh.to_vertex_handle(*fh_it).idx());
+			if (write_corners)
+				corners.push_back(_mesh.texcoord2D(*fh_it));
+		}
+	}
+	if (indices.size() != 3 * nf)
+	{
+		std::cerr << _filename << ": not a triangle mesh\n";
+		return false;
+	}
+
+	const void* data[N_SECTIONS] = { NULL };
+	data[POSITIONS] = nv ? _mesh.points() : NULL;
+	data[INDICES] = nf ? &indices[0] : NULL;
+	if (_opt.check(OpenMesh::IO::Options::VertexNormal) && _mesh.has_vertex_normals())
+		data[NORMALS] = _mesh.vertex_normals();
+	if (_opt.check(OpenMesh::IO::Options::VertexTexCoord) && _mesh.has_vertex_texcoords2D())
+		data[TEXCOORDS] = _mesh.texcoords2D();
+	if (write_corners && nf)
+		data[CORNER_TEXCOORDS] = &corners[0];
+	if (!data[POSITIONS] || !data[INDICES])
+	{
+		std::cerr << _filename << ": empty mesh\n";
+		return false;
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, 4);
+	header.version = VERSION;
+	header.n_vertices = (unsigned int)nv;
+	header.n_faces = (unsigned int)nf;
+
+	Mesh::Point bb_min = _mesh.point(*_mesh.vertices_begin()), bb_max = bb_min;
+	Mesh::ConstVertexIter v_it, v_end(_mesh.vertices_end());
+	for (v_it = _mesh.vertices_begin(); v_it != v_end; ++v_it)
+	{
+		bb_min.minimize(_mesh.point(*v_it));
+		bb_max.maximize(_mesh.point(*v_it));
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		header.bb_min[k] = bb_min[k];
+		header.bb_max[k] = bb_max[k];
+	}
+
+	header.hash = 14695981039346656037ULL;
+	size_t offset = align(sizeof(Header));
+	for (int s = 0; s < N_SECTIONS; s++)
+	{
+		if (!data[s])
+			continue;
+		size_t size = section_size((Section)s, nv, nf);
+		header.offset[s] = offset;
+		header.hash = hash_words(header.hash, data[s], size);
+		offset = align(offset + size);
+	}
+
+	std::ofstream out(_filename, std::ios::binary);
+	if (!out)
+	{
+		std::cerr << _filename << ": cannot write file\n";
+		return false;
+	}
+
+	static const char zeros[ALIGNMENT] = { 0 };
+	out.write((const char*)&header, sizeof(Header));
+	size_t pos = sizeof(Header);
+	for (int s = 0; s < N_SECTIONS; s++)
+	{
+		if (!data[s])
+			continue;
+		out.write(zeros, header.offset[s] - pos);
+		size_t size = section_size((Section)s, nv, nf);
+		out.write((const char*)data[s], size);
+		pos = (size_t)header.offset[s] + size;
+	}
+
+	if (!out)
+	{
+		std::cerr << _filename << ": cannot write file\n";
+		return false;
+	}
+	return true;
+}
+
+bool BinaryMesh::is_binary(const std::string& _filename)
+{
+	std::string ext = _filename.size() > 6 ? _filename.substr(_filename.size() - 6) : "";
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == ".pmesh";
+}
+
+bool BinaryMesh::read_mesh(Mesh& _mesh, const std::string& _filename)
+{
+	if (!is_binary(_filename))
+		return ObjReader::read_mesh(_mesh, _filename);
+
+	BinaryMesh file;
+	return file.open(_filename.c_str()) && file.build_mesh(_mesh) >= 0;
+}
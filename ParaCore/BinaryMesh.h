@@ -0,0 +1,85 @@
+#pragma once
+#include "MeshTypes.h"
+#include "MappedFile.h"
+#include <OpenMesh/Core/IO/Options.hh>
+#include <string>
+
+/// Binary mesh file (.pmesh) that is memory mapped and used in place:
+/// a header with the counts, the bounding box and a content hash,
+/// then 64 byte aligned sections of positions, triangle indices and,
+/// if they were written, vertex normals, vertex texcoords and per
+/// corner texcoords (in face order, like MeshBuffers' corners). The
+/// section pointers point into the mapping, nothing is parsed or
+/// copied until build_mesh(). Files are little endian.
+class BinaryMesh
+{
+public:
+	enum Section
+	{
+		POSITIONS,        ///< Mesh::Point per vertex
+		INDICES,          ///< 3 unsigned ints per face
+		NORMALS,          ///< Mesh::Normal per vertex
+		TEXCOORDS,        ///< Mesh::TexCoord2D per vertex
+		CORNER_TEXCOORDS, ///< Mesh::TexCoord2D per face corner
+		N_SECTIONS
+	};
+
+public:
+	BinaryMesh();
+
+	/// maps the file and checks the header and the section bounds
+	bool open(const char* _filename);
+	void close();
+
+	/// recomputes the content hash, reads the whole file
+	bool verify() const;
+
+	int n_vertices() const { return header_ ? (int)header_->n_vertices : 0; }
+	int n_faces() const { return header_ ? (int)header_->n_faces : 0; }
+	Mesh::Point bb_min() const;
+	Mesh::Point bb_max() const;
+	unsigned long long hash() const { return header_ ? header_->hash : 0; }
+
+	bool has(Section _s) const { return section(_s) != NULL; }
+	const Mesh::Point* points() const { return (const Mesh::Point*)section(POSITIONS); }
+	const unsigned int* indices() const { return (const unsigned int*)section(INDICES); }
+	const Mesh::Normal* normals() const { return (const Mesh::Normal*)section(NORMALS); }
+	const Mesh::TexCoord2D* texcoords() const { return (const Mesh::TexCoord2D*)section(TEXCOORDS); }
+	const Mesh::TexCoord2D* corner_texcoords() const { return (const Mesh::TexCoord2D*)section(CORNER_TEXCOORDS); }
+
+	/// Halfedge mesh of the file. Normals and texcoords are copied if
+	/// the file and _mesh both have them. Returns the faces added,
+	/// -1 if an index is out of range.
+	int build_mesh(Mesh& _mesh) const;
+
+	/// Writes positions and indices, plus vertex normals, vertex
+	/// texcoords and face texcoords as requested by _opt.
+	static bool write(const Mesh& _mesh, const char* _filename,
+		OpenMesh::IO::Options _opt = OpenMesh::IO::Options::Default);
+
+	/// the file name ends with .pmesh, in any case
+	static bool is_binary(const std::string& _filename);
+	/// .pmesh files through build_mesh(), ObjReader::read_mesh otherwise
+	static bool read_mesh(Mesh& _mesh, const std::string& _filename);
+
+private:
+	struct Header
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned int n_vertices;
+		unsigned int n_faces;
+		float bb_min[3];
+		float bb_max[3];
+		unsigned long long hash;                 ///< FNV-1a of the sections
+		unsigned long long offset[N_SECTIONS];   ///< 0 if not written
+	};
+
+	const char* section(Section _s) const;
+	static size_t section_size(Section _s, size_t _n_vertices, size_t _n_faces);
+	static unsigned long long hash_words(unsigned long long _h, const void* _data, size_t _bytes);
+
+private:
+	MappedFile file_;
+	const Header* header_;
+};
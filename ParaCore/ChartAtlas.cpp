@@ -0,0 +1,444 @@
+#include "ChartAtlas.h"
+#include "LSCMSystem.h"
+#include "MeshHierarchy.h"
+#include "PinSelection.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+// charts at least this large are solved one at a time with all
+// threads inside the CG, smaller ones run one chart per thread
+static const int BIG_CHART = 20000;
+
+
+ChartAtlas::ChartAtlas(Mesh& _mesh) :
+mesh_(_mesh), max_angle_(60.0f), max_faces_(0), padding_(0.002f),
+multilevel_(false), progress_(NULL), solver_time_(0.0), used_iterations_(0)
+{
+	mesh_.request_vertex_texcoords2D();
+	mesh_.request_halfedge_texcoords2D();
+}
+
+ChartAtlas::~ChartAtlas()
+{
+}
+
+bool ChartAtlas::solve()
+{
+	if (mesh_.n_vertices() < 3 || mesh_.n_faces() == 0)
+		return false;
+
+	collect_faces();
+	segment();
+	build_charts();
+
+	// largest charts first, so that the last ones to finish are small
+	int nb_charts = (int)charts_.size();
+	std::vector<int> order(nb_charts);
+	for (int c = 0; c < nb_charts; c++)
+		order[c] = c;
+	std::sort(order.begin(), order.end(), [this](int a, int b)
+	{
+		return charts_[a].mesh_faces.size() > charts_[b].mesh_faces.size();
+	});
+
+	if (progress_)
+		progress_->set_charts(0, nb_charts);
+
+	double t0 = omp_get_wtime();
+	int first_small = 0;
+	while (first_small < nb_charts && (int)charts_[order[first_small]].mesh_faces.size() >= BIG_CHART)
+		solve_chart(charts_[order[first_small++]]);
+
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = first_small; i < nb_charts; i++)
+		solve_chart(charts_[order[i]]);
+	solver_time_ = omp_get_wtime() - t0;
+
+	// a cancelled solve leaves the texcoords untouched
+	if (progress_ && progress_->cancelled())
+		return false;
+
+	used_iterations_ = 0;
+	for (int c = 0; c < nb_charts; c++)
+		used_iterations_ += charts_[c].iterations;
+
+	pack();
+	get_result();
+	return true;
+}
+
+void ChartAtlas::collect_faces()
+{
+	int nb_faces = mesh_.n_faces();
+	faces_.clear();
+	faces_.reserve(3 * nb_faces);
+
+	auto f_it(mesh_.faces_begin());
+	auto f_end(mesh_.faces_end());
+	for (; f_it != f_end; f_it++)
+	{
+		auto fv = mesh_.fv_begin(*f_it);
+		for (int i = 0; i < 3; i++, fv++)
+			faces_.push_back((*fv).idx());
+	}
+
+	// unit normal and area of every face
+	const Mesh::Point* points = mesh_.points();
+	face_normal_.resize(nb_faces);
+	face_area_.resize(nb_faces);
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < nb_faces; f++)
+	{
+		const int* id = &faces_[3 * f];
+		Vec3f n = (points[id[1]] - points[id[0]]) % (points[id[2]] - points[id[0]]);
+		float len = n.norm();
+		face_area_[f] = 0.5f * len;
+		face_normal_[f] = len > 0.0f ? n / len : Vec3f(0.0f, 0.0f, 0.0f);
+	}
+}
+
+// Neighbor of face f across the edge (corner k, corner k+1) is
+// _adj[3f+k], -1 on boundary and non-manifold edges. Edges are
+// sorted by their vertex pair, so no halfedge structure is needed.
+void ChartAtlas::face_adjacency(std::vector<int>& _adj) const
+{
+	int nb_corners = (int)faces_.size();
+	std::vector<std::pair<long long, int> > edges(nb_corners);
+	for (int e = 0; e < nb_corners; e++)
+	{
+		int f = e / 3;
+		int v0 = faces_[e];
+		int v1 = faces_[3 * f + (e + 1) % 3];
+		if (v0 > v1)
+			std::swap(v0, v1);
+		edges[e] = std::make_pair(((long long)v0 << 32) | (unsigned)v1, e);
+	}
+	std::sort(edges.begin(), edges.end());
+
+	_adj.assign(nb_corners, -1);
+	for (int i = 0; i < nb_corners;)
+	{
+		int j = i + 1;
+		while (j < nb_corners && edges[j].first == edges[i].first)
+			j++;
+		if (j - i == 2)
+		{
+			_adj[edges[i].second] = edges[i + 1].second / 3;
+			_adj[edges[i + 1].second] = edges[i].second / 3;
+		}
+		i = j;
+	}
+}
+
+// Region growing: a chart takes neighbors whose normal stays within
+// max_angle_ of the area weighted chart normal. The normal cone keeps
+// charts close to height fields, which LSCM maps without folds.
+void ChartAtlas::segment()
+{
+	int nb_faces = (int)face_area_.size();
+	std::vector<int> adj;
+	face_adjacency(adj);
+
+	float cos_max = std::cos(max_angle_ * 3.14159265f / 180.0f);
+	face_chart_.assign(nb_faces, -1);
+	std::vector<int> queue;
+	queue.reserve(nb_faces);
+
+	int nb_charts = 0;
+	for (int seed = 0; seed < nb_faces; seed++)
+	{
+		if (face_chart_[seed] >= 0)
+			continue;
+
+		int chart = nb_charts++;
+		Vec3f sum = face_normal_[seed] * face_area_[seed];
+		Vec3f normal = face_normal_[seed];
+		int size = 1;
+		face_chart_[seed] = chart;
+		queue.clear();
+		queue.push_back(seed);
+
+		for (size_t q = 0; q < queue.size(); q++)
+		{
+			int f = queue[q];
+			for (int k = 0; k < 3; k++)
+			{
+				int g = adj[3 * f + k];
+				if (g < 0 || face_chart_[g] >= 0)
+					continue;
+				if (max_faces_ > 0 && size >= max_faces_)
+					break;
+				// degenerate faces join whatever chart reaches them
+				if (face_area_[g] > 0.0f && (face_normal_[g] | normal) < cos_max)
+					continue;
+
+				face_chart_[g] = chart;
+				queue.push_back(g);
+				size++;
+
+				sum += face_normal_[g] * face_area_[g];
+				float len = sum.norm();
+				if (len > 0.0f)
+					normal = sum / len;
+			}
+		}
+	}
+}
+
+void ChartAtlas::build_charts()
+{
+	int nb_faces = (int)face_chart_.size();
+	int nb_charts = 0;
+	for (int f = 0; f < nb_faces; f++)
+		nb_charts = std::max(nb_charts, face_chart_[f] + 1);
+
+	charts_.assign(nb_charts, Chart());
+	for (int f = 0; f < nb_faces; f++)
+		charts_[face_chart_[f]].mesh_faces.push_back(f);
+
+	// mesh --> local vertex index, reset after every chart
+	std::vector<int> local(mesh_.n_vertices(), -1);
+	for (int c = 0; c < nb_charts; c++)
+	{
+		Chart& chart = charts_[c];
+		chart.faces.reserve(3 * chart.mesh_faces.size());
+		chart.normal = Vec3f(0.0f, 0.0f, 0.0f);
+		chart.area = 0.0f;
+		chart.iterations = 0;
+
+		for (size_t i = 0; i < chart.mesh_faces.size(); i++)
+		{
+			int f = chart.mesh_faces[i];
+			for (int k = 0; k < 3; k++)
+			{
+				int v = faces_[3 * f + k];
+				if (local[v] < 0)
+				{
+					local[v] = (int)chart.vertices.size();
+					chart.vertices.push_back(v);
+				}
+				chart.faces.push_back(local[v]);
+			}
+			chart.normal += face_normal_[f] * face_area_[f];
+			chart.area += face_area_[f];
+		}
+
+		for (size_t i = 0; i < chart.vertices.size(); i++)
+			local[chart.vertices[i]] = -1;
+	}
+}
+
+// Same scheme as the single chart solver, but the initial guess
+// projects onto the chart plane and the pins are the ends of its
+// boundary diameter, or its extreme vertices. The result is scaled
+// to the surface area of the chart.
+void ChartAtlas::solve_chart(Chart& _chart) const
+{
+	if (progress_ && progress_->cancelled())
+		return;
+
+	int n = (int)_chart.vertices.size();
+	const Mesh::Point* points = mesh_.points();
+
+	std::vector<Mesh::Point> p(n);
+	for (int i = 0; i < n; i++)
+		p[i] = points[_chart.vertices[i]];
+
+	// tangent frame of the chart plane
+	Vec3f normal = _chart.normal;
+	if (normal.norm() == 0.0f)
+		normal = Vec3f(0.0f, 0.0f, 1.0f);
+	normal.normalize();
+	int axis = 0;
+	for (int d = 1; d < 3; d++)
+	{
+		if (std::fabs(normal[d]) < std::fabs(normal[axis]))
+			axis = d;
+	}
+	Vec3f e(0.0f, 0.0f, 0.0f);
+	e[axis] = 1.0f;
+	Vec3f t1 = (normal % e).normalize();
+	Vec3f t2 = normal % t1;
+
+	std::vector<double>& x = _chart.uv;
+	x.resize(2 * n);
+	int lock[2] = { 0, 0 };
+	for (int i = 0; i < n; i++)
+	{
+		x[2 * i] = p[i] | t1;
+		x[2 * i + 1] = p[i] | t2;
+		if (x[2 * i] > x[2 * lock[0]])
+			lock[0] = i;
+		if (x[2 * i] < x[2 * lock[1]])
+			lock[1] = i;
+	}
+	int pins[2];
+	if (select_pins(&p[0], n, _chart.faces, pins) && pins_separated(&p[0], x, pins))
+	{
+		lock[0] = pins[0];
+		lock[1] = pins[1];
+	}
+
+	if (lock[0] != lock[1])
+	{
+		if (multilevel_)
+		{
+			MeshHierarchy hierarchy;
+			hierarchy.build(&p[0], n, _chart.faces, lock);
+			if (hierarchy.n_levels() > 0)
+				hierarchy.solve(x);
+		}
+
+		std::vector<unsigned char> locked(2 * n, 0);
+		for (int i = 0; i < 2; i++)
+			locked[2 * lock[i]] = locked[2 * lock[i] + 1] = 1;
+
+		LSCMSystem system;
+		system.assemble(&p[0], n, _chart.faces);
+		double tolerance = progress_ ? progress_->tolerance() : 1e-10;
+		_chart.iterations = system.solve_cg(x, locked, 5 * n, tolerance, progress_);
+	}
+
+	// keep the orientation, and match the surface area
+	double uv_area = 0.0;
+	for (size_t i = 0; i < _chart.faces.size(); i += 3)
+	{
+		const int* id = &_chart.faces[i];
+		double ux = x[2 * id[1]] - x[2 * id[0]], uy = x[2 * id[1] + 1] - x[2 * id[0] + 1];
+		double vx = x[2 * id[2]] - x[2 * id[0]], vy = x[2 * id[2] + 1] - x[2 * id[0] + 1];
+		uv_area += 0.5 * (ux * vy - uy * vx);
+	}
+	double sy = uv_area < 0.0 ? -1.0 : 1.0;
+	double s = std::fabs(uv_area) > 0.0 ? std::sqrt(_chart.area / std::fabs(uv_area)) : 1.0;
+	for (int i = 0; i < n; i++)
+	{
+		x[2 * i] *= s;
+		x[2 * i + 1] *= s * sy;
+	}
+
+	_chart.bb_min = _chart.bb_max = Vec2f((float)x[0], (float)x[1]);
+	for (int i = 1; i < n; i++)
+	{
+		Vec2f uv((float)x[2 * i], (float)x[2 * i + 1]);
+		_chart.bb_min.minimize(uv);
+		_chart.bb_max.maximize(uv);
+	}
+
+	if (progress_)
+		progress_->add_chart();
+}
+
+// Shelf packing: islands are turned so that they are wider than
+// tall, sorted by height and laid out in rows of a square atlas.
+void ChartAtlas::pack()
+{
+	int nb_charts = (int)charts_.size();
+	double total = 0.0;
+	for (int c = 0; c < nb_charts; c++)
+	{
+		Chart& chart = charts_[c];
+		Vec2f size = chart.bb_max - chart.bb_min;
+		if (size[1] > size[0])
+		{
+			// rotate by 90 degrees, (u,v) --> (-v,u)
+			for (size_t i = 0; i < chart.uv.size(); i += 2)
+			{
+				double u = chart.uv[i];
+				chart.uv[i] = -chart.uv[i + 1];
+				chart.uv[i + 1] = u;
+			}
+			Vec2f bb_min = chart.bb_min;
+			chart.bb_min = Vec2f(-chart.bb_max[1], bb_min[0]);
+			chart.bb_max = Vec2f(-bb_min[1], chart.bb_max[0]);
+		}
+		total += (double)size[0] * size[1];
+	}
+
+	// rows as wide as a square holding all padded islands
+	double pad = padding_ * std::sqrt(total);
+	double width = 0.0, padded = 0.0;
+	std::vector<int> order(nb_charts);
+	for (int c = 0; c < nb_charts; c++)
+	{
+		order[c] = c;
+		Vec2f size = charts_[c].bb_max - charts_[c].bb_min;
+		width = std::max(width, size[0] + 2.0 * pad);
+		padded += (size[0] + 2.0 * pad) * (size[1] + 2.0 * pad);
+	}
+	width = std::max(width, std::sqrt(padded));
+	std::sort(order.begin(), order.end(), [this](int a, int b)
+	{
+		return charts_[a].bb_max[1] - charts_[a].bb_min[1] >
+			charts_[b].bb_max[1] - charts_[b].bb_min[1];
+	});
+
+	// place the islands, uv then holds atlas coordinates
+	double x = 0.0, y = 0.0, shelf = 0.0, used = 0.0;
+	for (int i = 0; i < nb_charts; i++)
+	{
+		Chart& chart = charts_[order[i]];
+		double w = chart.bb_max[0] - chart.bb_min[0] + 2.0 * pad;
+		double h = chart.bb_max[1] - chart.bb_min[1] + 2.0 * pad;
+		if (x > 0.0 && x + w > width)
+		{
+			y += shelf;
+			x = shelf = 0.0;
+		}
+
+		double ox = x + pad - chart.bb_min[0];
+		double oy = y + pad - chart.bb_min[1];
+		for (size_t k = 0; k < chart.uv.size(); k += 2)
+		{
+			chart.uv[k] += ox;
+			chart.uv[k + 1] += oy;
+		}
+
+		x += w;
+		used = std::max(used, x);
+		shelf = std::max(shelf, h);
+	}
+
+	// Normalize
+	double extent = std::max(used, y + shelf);
+	double scale = extent > 0.0 ? 1.0 / extent : 1.0;
+	for (int c = 0; c < nb_charts; c++)
+	{
+		std::vector<double>& uv = charts_[c].uv;
+		for (size_t k = 0; k < uv.size(); k++)
+			uv[k] *= scale;
+	}
+}
+
+void ChartAtlas::get_result()
+{
+	// position of every face inside its chart
+	int nb_faces = (int)face_chart_.size();
+	std::vector<int> face_local(nb_faces);
+	for (size_t c = 0; c < charts_.size(); c++)
+	{
+		const std::vector<int>& mf = charts_[c].mesh_faces;
+		for (size_t i = 0; i < mf.size(); i++)
+			face_local[mf[i]] = (int)i;
+	}
+
+	auto f_it(mesh_.faces_begin());
+	auto f_end(mesh_.faces_end());
+	for (; f_it != f_end; f_it++)
+	{
+		int f = (*f_it).idx();
+		const Chart& chart = charts_[face_chart_[f]];
+		const int* id = &faces_[3 * f];
+		const int* lid = &chart.faces[3 * face_local[f]];
+
+		for (auto fh = mesh_.fh_iter(*f_it); fh.is_valid(); ++fh)
+		{
+			int v = mesh_.to_vertex_handle(*fh).idx();
+			int k = v == id[0] ? 0 : (v == id[1] ? 1 : 2);
+			Vec2f tc((float)chart.uv[2 * lid[k]], (float)chart.uv[2 * lid[k] + 1]);
+			mesh_.set_texcoord2D(*fh, tc);
+			// seam vertices keep the texcoord of one of their charts
+			mesh_.set_texcoord2D(mesh_.to_vertex_handle(*fh), tc);
+		}
+	}
+}
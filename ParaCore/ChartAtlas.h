@@ -0,0 +1,78 @@
+#pragma once
+#include "MeshTypes.h"
+#include "SolverProgress.h"
+#include <vector>
+
+/// Multi-chart LSCM. The mesh is split into disc-like charts by
+/// growing regions of faces with similar normals, every chart is
+/// parameterized independently (charts run in parallel, largest
+/// first), and the UV islands are packed into one [0,1]^2 atlas.
+/// Seams get one texcoord per chart, so the result is written to the
+/// halfedge texcoords of the mesh.
+class ChartAtlas
+{
+public:
+	ChartAtlas(Mesh& _mesh);
+	~ChartAtlas();
+
+	/// largest angle (degrees) between a face normal and the average
+	/// normal of its chart
+	void set_max_angle(float _degrees) { max_angle_ = _degrees; }
+	/// upper bound on the faces of a chart, 0 for no bound
+	void set_max_faces(int _n) { max_faces_ = _n; }
+	/// empty space around every island, relative to the atlas size
+	void set_padding(float _padding) { padding_ = _padding; }
+	/// multilevel initial guess for large charts
+	void set_multilevel(bool _b) { multilevel_ = _b; }
+	/// report finished charts and allow cancellation (NULL disables it)
+	void set_progress(SolverProgress* _progress) { progress_ = _progress; }
+
+	/// segment, parameterize and pack
+	bool solve();
+
+	/// chart index of every face
+	const std::vector<int>& face_charts() const { return face_chart_; }
+	int n_charts() const { return (int)charts_.size(); }
+
+	/// statistics of the last solve, iterations summed over charts
+	double solver_time() const { return solver_time_; }
+	int used_iterations() const { return used_iterations_; }
+
+private:
+	struct Chart
+	{
+		std::vector<int> vertices;  ///< local --> mesh vertex
+		std::vector<int> faces;     ///< 3 local vertex indices per face
+		std::vector<int> mesh_faces;
+		Vec3f normal;
+		float area;
+		std::vector<double> uv;     ///< 2 per local vertex
+		Vec2f bb_min, bb_max;
+		int iterations;
+	};
+
+	void collect_faces();
+	void face_adjacency(std::vector<int>& _adj) const;
+	void segment();
+	void build_charts();
+	void solve_chart(Chart& _chart) const;
+	void pack();
+	void get_result();
+
+private:
+	Mesh& mesh_;
+	float max_angle_;
+	int max_faces_;
+	float padding_;
+	bool multilevel_;
+	SolverProgress* progress_;
+
+	std::vector<int> faces_;
+	std::vector<Vec3f> face_normal_;
+	std::vector<float> face_area_;
+	std::vector<int> face_chart_;
+	std::vector<Chart> charts_;
+
+	double solver_time_;
+	int used_iterations_;
+};
@@ -0,0 +1,201 @@
+#include "DistortionMetrics.h"
+#include "TriangleKernel.h"
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+
+DistortionMetrics::DistortionMetrics(const Mesh& _mesh) :
+mesh_(_mesh), l2_stretch_(0.0), n_flipped_(0), n_degenerate_(0), time_(0.0)
+{
+	for (int m = 0; m < N_METRICS; m++)
+	{
+		Summary empty = { 0.0, 0.0, 0.0, 0.0 };
+		summary_[m] = empty;
+		std::fill(histogram_[m].count, histogram_[m].count + N_BINS, 0);
+	}
+}
+
+double DistortionMetrics::bin_start(int _k)
+{
+	return std::pow(2.0, _k / 4.0);
+}
+
+bool DistortionMetrics::compute(bool _corners)
+{
+	if (_corners ? !mesh_.has_halfedge_texcoords2D() : !mesh_.has_vertex_texcoords2D())
+		return false;
+
+	double t0 = omp_get_wtime();
+	int nb_faces = (int)mesh_.n_faces();
+	for (int m = 0; m < N_METRICS; m++)
+		values_[m].resize(nb_faces);
+	surface_area_.resize(nb_faces);
+
+	// singular values and the signed texture area, per face
+	std::vector<float> s1(nb_faces), s2(nb_faces), det(nb_faces);
+	double surface = 0.0, texture = 0.0, oriented = 0.0, sander = 0.0;
+
+	int nb_blocks = (nb_faces + FACE_BLOCK - 1) / FACE_BLOCK;
+#pragma omp parallel for schedule(static) reduction(+:surface,texture,oriented,sander)
+	for (int blk = 0; blk < nb_blocks; blk++)
+	{
+		int f0 = blk * FACE_BLOCK;
+		int n = std::min((int)FACE_BLOCK, nb_faces - f0);
+
+		float px[3][FACE_BLOCK], py[3][FACE_BLOCK], pz[3][FACE_BLOCK];
+		float tu[3][FACE_BLOCK], tv[3][FACE_BLOCK];
+		for (int i = 0; i < n; i++)
+		{
+			int k = 0;
+			for (auto fh_it = mesh_.cfh_iter(Mesh::FaceHandle(f0 + i)); fh_it.is_valid() && k < 3; ++fh_it, ++k)
+			{
+				Mesh::VertexHandle vh = mesh_.to_vertex_handle(*fh_it);
+				const Mesh::Point& p = mesh_.point(vh);
+				const Mesh::TexCoord2D& t = _corners ? mesh_.texcoord2D(*fh_it) : mesh_.texcoord2D(vh);
+				px[k][i] = p[0];
+				py[k][i] = p[1];
+				pz[k][i] = p[2];
+				tu[k][i] = t[0];
+				tv[k][i] = t[1];
+			}
+		}
+
+		TriangleCorners tri = { { px[0], px[1], px[2] },
+		                        { py[0], py[1], py[2] },
+		                        { pz[0], pz[1], pz[2] } };
+		float fa[FACE_BLOCK], fc[FACE_BLOCK], fd[FACE_BLOCK];
+		project_triangles(tri, n, fa, fc, fd);
+
+		// The triangle is (0,0), (a,0), (c,d) in its local frame, so the
+		// Jacobian columns are J_x = (t1 - t0) / a and
+		// J_y = (t2 - t0 - c J_x) / d. Branch free, so it vectorizes.
+		for (int i = 0; i < n; i++)
+		{
+			float a = fa[i], c = fc[i], d = fd[i];
+			float inv_a = a > 0.0f ? 1.0f / a : 0.0f;
+			float inv_d = d > 0.0f ? 1.0f / d : 0.0f;
+
+			float e = (tu[1][i] - tu[0][i]) * inv_a;
+			float g = (tv[1][i] - tv[0][i]) * inv_a;
+			float f = (tu[2][i] - tu[0][i] - c * e) * inv_d;
+			float h = (tv[2][i] - tv[0][i] - c * g) * inv_d;
+
+			float E = e * e + g * g, G = f * f + h * h, F = e * f + g * h;
+			float D = e * h - f * g;
+			float half = 0.5f * (E - G);
+			float big = std::sqrt(0.5f * (E + G) + std::sqrt(half * half + F * F));
+
+			int fi = f0 + i;
+			s1[fi] = big;
+			s2[fi] = big > 0.0f ? std::fabs(D) / big : 0.0f;
+			det[fi] = D;
+			surface_area_[fi] = 0.5f * a * d;
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			int fi = f0 + i;
+			double A = surface_area_[fi];
+			surface += A;
+			texture += A * std::fabs(det[fi]);
+			oriented += A * det[fi];
+			if (s2[fi] > 0.0f && A > 0.0)
+				sander += A * 0.5 * (1.0 / ((double)s1[fi] * s1[fi]) + 1.0 / ((double)s2[fi] * s2[fi]));
+		}
+	}
+
+	double scale = surface > 0.0 ? std::sqrt(texture / surface) : 0.0;
+	l2_stretch_ = surface > 0.0 ? std::sqrt(sander / surface) * scale : 0.0;
+
+	// the orientation of most of the texture area is the right one
+	float sign = oriented < 0.0 ? -1.0f : 1.0f;
+	float s = (float)scale;
+	int flipped = 0, degenerate = 0;
+#pragma omp parallel for schedule(static) reduction(+:flipped,degenerate)
+	for (int f = 0; f < nb_faces; f++)
+	{
+		if (surface_area_[f] <= 0.0f || s2[f] <= 0.0f || s <= 0.0f)
+		{
+			values_[ANGLE][f] = values_[AREA][f] = values_[STRETCH][f] = 0.0f;
+			degenerate++;
+			continue;
+		}
+		float r = s1[f] * s2[f] / (s * s);
+		values_[ANGLE][f] = s1[f] / s2[f];
+		values_[AREA][f] = std::max(r, 1.0f / r);
+		values_[STRETCH][f] = std::max(s1[f] / s, s / s2[f]);
+		if (det[f] * sign < 0.0f)
+			flipped++;
+	}
+	n_flipped_ = flipped;
+	n_degenerate_ = degenerate;
+
+	for (int m = 0; m < N_METRICS; m++)
+		summarize((Metric)m);
+
+	time_ = omp_get_wtime() - t0;
+	return true;
+}
+
+void DistortionMetrics::summarize(Metric _m)
+{
+	const std::vector<float>& v = values_[_m];
+	Summary& sum = summary_[_m];
+	Histogram& hist = histogram_[_m];
+	std::fill(hist.count, hist.count + N_BINS, 0);
+
+	std::vector<float> valid;
+	valid.reserve(v.size());
+	double weighted = 0.0, weight = 0.0;
+	for (size_t f = 0; f < v.size(); f++)
+	{
+		if (v[f] <= 0.0f)
+			continue;
+		valid.push_back(v[f]);
+		weighted += (double)surface_area_[f] * v[f];
+		weight += surface_area_[f];
+
+		int bin = (int)(4.0f * std::log(v[f]) / std::log(2.0f));
+		hist.count[std::max(0, std::min((int)N_BINS - 1, bin))]++;
+	}
+
+	Summary empty = { 0.0, 0.0, 0.0, 0.0 };
+	sum = empty;
+	if (valid.empty())
+		return;
+
+	size_t n = valid.size();
+	sum.mean = weight > 0.0 ? weighted / weight : 0.0;
+	std::nth_element(valid.begin(), valid.begin() + (n - 1) / 2, valid.end());
+	sum.median = valid[(n - 1) / 2];
+	size_t k95 = (size_t)(0.95 * (n - 1));
+	std::nth_element(valid.begin(), valid.begin() + k95, valid.end());
+	sum.p95 = valid[k95];
+	sum.max = *std::max_element(valid.begin() + k95, valid.end());
+}
+
+std::string DistortionMetrics::json() const
+{
+	static const char* names[N_METRICS] = { "angle", "area", "stretch" };
+
+	std::ostringstream out;
+	out << "{\"faces\":" << values_[ANGLE].size()
+	    << ",\"flipped\":" << n_flipped_
+	    << ",\"degenerate\":" << n_degenerate_
+	    << ",\"l2_stretch\":" << l2_stretch_
+	    << ",\"time_s\":" << time_;
+	for (int m = 0; m < N_METRICS; m++)
+	{
+		const Summary& s = summary_[m];
+		out << ",\"" << names[m] << "\":{\"mean\":" << s.mean
+		    << ",\"median\":" << s.median << ",\"p95\":" << s.p95
+		    << ",\"max\":" << s.max << ",\"histogram\":[";
+		for (int k = 0; k < N_BINS; k++)
+			out << (k ? "," : "") << histogram_[m].count[k];
+		out << "]}";
+	}
+	out << "}";
+	return out.str();
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "MeshTypes.h"
+#include <string>
+#include <vector>
+
+/// Distortion of a solved parameterization. For every face the
+/// Jacobian of the map from the triangle to its texcoords has the
+/// singular values s1 >= s2, and s = sqrt(texture area / surface area)
+/// is the global scale. Three per-face factors follow, all 1 for an
+/// undistorted face and growing with the distortion:
+///   angle   = s1 / s2                    (conformal distortion)
+///   area    = max(s1 s2 / s^2, s^2 / (s1 s2))
+///   stretch = max(s1 / s, s / s2)         (worst direction)
+/// Faces with a zero surface or texture area are degenerate and left
+/// out (factor 0). Flipped faces are oriented against the majority.
+class DistortionMetrics
+{
+public:
+	enum Metric { ANGLE, AREA, STRETCH, N_METRICS };
+
+	/// bin k holds factors with log2 in [k/4, (k+1)/4), the last bin
+	/// everything above
+	enum { N_BINS = 16 };
+
+	struct Summary
+	{
+		double mean;    ///< weighted by surface area
+		double median;
+		double p95;
+		double max;
+	};
+
+	struct Histogram
+	{
+		int count[N_BINS];
+	};
+
+	enum { FACE_BLOCK = 64 };
+
+public:
+	DistortionMetrics(const Mesh& _mesh);
+
+	/// _corners reads the halfedge texcoords (ChartAtlas) instead of
+	/// the vertex texcoords. False if the mesh has no such texcoords.
+	bool compute(bool _corners = false);
+
+	/// per face factors
+	const std::vector<float>& values(Metric _m) const { return values_[_m]; }
+	const Summary& summary(Metric _m) const { return summary_[_m]; }
+	const Histogram& histogram(Metric _m) const { return histogram_[_m]; }
+	/// lower end of bin _k
+	static double bin_start(int _k);
+
+	/// Sander's L2 stretch, normalized to 1 for an isometry up to scale
+	double l2_stretch() const { return l2_stretch_; }
+	int n_flipped() const { return n_flipped_; }
+	int n_degenerate() const { return n_degenerate_; }
+	double time() const { return time_; }
+
+	/// summaries, histograms and counts as one JSON object
+	std::string json() const;
+
+private:
+	void summarize(Metric _m);
+
+private:
+	const Mesh& mesh_;
+
+	std::vector<float> values_[N_METRICS];
+	std::vector<float> surface_area_;
+	Summary summary_[N_METRICS];
+	Histogram histogram_[N_METRICS];
+
+	double l2_stretch_;
+	int n_flipped_;
+	int n_degenerate_;
+	double time_;
+};
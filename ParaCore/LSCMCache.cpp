@@ -0,0 +1,41 @@
+#include "LSCMCache.h"
+
+
+// FNV-1a over the vertex count and the face list
+unsigned long long LSCMCache::key(const std::vector<int>& _faces, int _n_vertices)
+{
+	unsigned long long h = 14695981039346656037ULL;
+	h = (h ^ (unsigned)_n_vertices) * 1099511628211ULL;
+	for (size_t i = 0; i < _faces.size(); i++)
+		h = (h ^ (unsigned)_faces[i]) * 1099511628211ULL;
+	return h;
+}
+
+LSCMCache::Entry* LSCMCache::find(const std::vector<int>& _faces, int _n_vertices)
+{
+	auto it = entries_.find(key(_faces, _n_vertices));
+	if (it == entries_.end())
+		return NULL;
+
+	// guard against hash collisions
+	Entry& e = it->second;
+	if (e.n_vertices != _n_vertices || e.faces != _faces)
+		return NULL;
+	return &e;
+}
+
+LSCMCache::Entry& LSCMCache::insert(const std::vector<int>& _faces, int _n_vertices)
+{
+	Entry& e = entries_[key(_faces, _n_vertices)];
+	if (e.n_vertices != _n_vertices || e.faces != _faces)
+	{
+		e.n_vertices = _n_vertices;
+		e.faces = _faces;
+		e.lock[0] = e.lock[1] = 0;
+		e.solution.clear();
+		e.reordered = false;
+		e.ordering = MeshOrdering();
+		e.pattern.reset();
+	}
+	return e;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "LSCMSystem.h"
+#include "MeshOrdering.h"
+#include <vector>
+#include <map>
+#include <cstddef>
+
+/// Data reused across meshes that share their triangles (animation
+/// frames, blendshapes), keyed on connectivity: the pinned vertices,
+/// the last solution, which warm-starts the next solve, and the
+/// symbolic work of the system (vertex ordering and sparsity
+/// pattern), so that the next assembly only computes the values.
+class LSCMCache
+{
+public:
+	struct Entry
+	{
+		Entry() : n_vertices(0), reordered(false) { lock[0] = lock[1] = 0; }
+
+		int n_vertices;
+		std::vector<int> faces;        ///< 3 vertex indices per face
+		int lock[2];                   ///< pinned vertices
+		std::vector<double> solution;  ///< last solution, (u,v) per vertex
+		bool reordered;                ///< pattern is in the numbering of ordering
+		MeshOrdering ordering;         ///< vertex order of a reordered solve
+		LSCMSystem::PatternPtr pattern; ///< rows of the system, NULL if none were assembled
+	};
+
+public:
+	/// entry for this connectivity, NULL if it was never solved
+	Entry* find(const std::vector<int>& _faces, int _n_vertices);
+
+	/// entry for this connectivity, created (or replaced) if needed
+	Entry& insert(const std::vector<int>& _faces, int _n_vertices);
+
+	void clear() { entries_.clear(); }
+	size_t size() const { return entries_.size(); }
+
+private:
+	static unsigned long long key(const std::vector<int>& _faces, int _n_vertices);
+
+private:
+	std::map<unsigned long long, Entry> entries_;
+};
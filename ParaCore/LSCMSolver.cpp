@@ -0,0 +1,561 @@
+#include "LSCMSolver.h"
+#include "MeshHierarchy.h"
+#include "PinSelection.h"
+#include <NL/nl.h>
+#include <omp.h>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// OpenNL keeps one current context for the whole process, so solvers
+// running on several threads (batch jobs, the viewer's worker) take
+// their OpenNL solves in turn. A file scope static, VS2013 does not
+// initialize function statics thread safely.
+static std::mutex opennl_mutex;
+
+
+LSCMSolver::LSCMSolver(Mesh& _mesh) :
+mesh_(_mesh), solver_type_(SOLVER_CG), indices_(NULL), reorder_(false), cache_(NULL), multilevel_(false), progress_(NULL), telemetry_(NULL),
+write_mesh_(true), solver_time_(0.0), used_iterations_(0), used_cache_(false)
+{
+	lock_[0] = lock_[1] = 0;
+	pins_[0] = pins_[1] = -1;
+	timings_.setup = timings_.assemble = timings_.solve = timings_.result = 0.0;
+	mesh_.request_vertex_texcoords2D();
+}
+
+LSCMSolver::~LSCMSolver()
+{
+}
+
+bool LSCMSolver::solve()
+{
+	int nb_vertices = mesh_.n_vertices();
+	if (nb_vertices < 3 || mesh_.n_faces() == 0)
+		return false;
+
+	double t0 = omp_get_wtime();
+	stage("bbox");
+	update_bbox();
+	stage("collect_faces");
+	collect_faces();
+	stage("init_slover");
+
+	// Same connectivity as a cached mesh: keep its pins and
+	// warm-start from its solution, only the numbers change
+	LSCMCache::Entry* entry = cache_ ? cache_->find(faces_, nb_vertices) : NULL;
+	used_cache_ = entry != NULL;
+
+	if (entry)
+		init_from_cache(*entry);
+	else
+	{
+		init_slover();
+		if (multilevel_)
+			init_multilevel();
+	}
+	double t1 = omp_get_wtime();
+	stage("setup_LSCM");
+	setup_LSCM(entry);
+	double t2 = omp_get_wtime();
+	stage("solve");
+	if (progress_ && progress_->cancelled())
+	{
+		stage(NULL);
+		return false;
+	}
+
+	bool ok = solver_type_ == SOLVER_CG || solver_type_ == SOLVER_SUPERLU ||
+		solver_type_ == SOLVER_CHOLMOD ? solve_opennl() : solve_parallel_cg();
+	restore_order();
+	double t3 = omp_get_wtime();
+	stage("get_result");
+
+	// a cancelled solve leaves the texcoords untouched
+	if (progress_ && progress_->cancelled())
+	{
+		stage(NULL);
+		return false;
+	}
+
+	// Get results
+	if (ok && cache_)
+		update_cache();
+	get_result();
+	stage(NULL);
+	if (telemetry_)
+	{
+		telemetry_->set_counter("vertices", nb_vertices);
+		telemetry_->set_counter("faces", (double)faces_.size() / 3);
+		telemetry_->set_counter("nnz", LSCMSystem::NNZ_PER_ROW * system_.n_rows());
+		telemetry_->set_counter("iterations", used_iterations_);
+	}
+
+	timings_.setup = t1 - t0;
+	timings_.assemble = t2 - t1;
+	timings_.solve = t3 - t2;
+	timings_.result = omp_get_wtime() - t3;
+	return ok;
+}
+
+bool LSCMSolver::solve_opennl()
+{
+	int nb_vertices = mesh_.n_vertices();
+
+	std::lock_guard<std::mutex> lock(opennl_mutex);
+	nlNewContext();
+	setup_solver(nb_vertices);
+	nlSolverParameteri(NL_NB_VARIABLES, 2 * nb_vertices);
+	nlSolverParameteri(NL_LEAST_SQUARES, NL_TRUE);
+
+	nlBegin(NL_SYSTEM);
+	for (int i = 0; i < 2 * nb_vertices; i++)
+		nlSetVariable(i, x_[i]);
+	for (int i = 0; i < 2; i++)
+	{
+		nlLockVariable(2 * lock_[i]);
+		nlLockVariable(2 * lock_[i] + 1);
+	}
+
+	// rows come from the parallel assembled CSR system
+	nlBegin(NL_MATRIX);
+	for (int r = 0; r < system_.n_rows(); r++)
+	{
+		const int* col = system_.row_cols(r);
+		const double* val = system_.row_values(r);
+		nlBegin(NL_ROW);
+		for (int k = 0; k < LSCMSystem::NNZ_PER_ROW; k++)
+			nlCoefficient(col[k], val[k]);
+		nlEnd(NL_ROW);
+	}
+	nlEnd(NL_MATRIX);
+	nlEnd(NL_SYSTEM);
+	bool ok = nlSolve() == NL_TRUE;
+
+	for (int i = 0; i < 2 * nb_vertices; i++)
+		x_[i] = nlGetVariable(i);
+
+	// Keep time and iter_num
+	NLint iterations;
+	nlGetDoublev(NL_ELAPSED_TIME, &solver_time_);
+	nlGetIntergerv(NL_USED_ITERATIONS, &iterations);
+	used_iterations_ = iterations;
+
+	nlDeleteContext(nlGetCurrent());
+	return ok;
+}
+
+double LSCMSolver::tolerance() const
+{
+	return progress_ ? progress_->tolerance() : 1e-10;
+}
+
+// next stage of the telemetry, NULL ends the last one
+void LSCMSolver::stage(const char* _name)
+{
+	if (!telemetry_)
+		return;
+	if (_name)
+		telemetry_->begin(_name);
+	else
+		telemetry_->end();
+}
+
+// The fixed texcoords are already normalized, and LSCM does not
+// depend on the scale, so the region is solved in texcoord space and
+// written back without normalizing again.
+bool LSCMSolver::solve_region(const std::vector<int>& _faces, int _rings)
+{
+	int nb_faces = mesh_.n_faces();
+	double t0 = omp_get_wtime();
+	stage("collect_faces");
+
+	// grow the edit ring by ring through the faces around its vertices
+	std::unordered_set<int> in_region;
+	std::vector<int> region;
+	for (size_t i = 0; i < _faces.size(); i++)
+	{
+		if (_faces[i] >= 0 && _faces[i] < nb_faces && in_region.insert(_faces[i]).second)
+			region.push_back(_faces[i]);
+	}
+	if (region.empty())
+	{
+		stage(NULL);
+		return true;
+	}
+
+	size_t ring_begin = 0;
+	for (int ring = 0; ring < _rings; ring++)
+	{
+		size_t ring_end = region.size();
+		for (size_t i = ring_begin; i < ring_end; i++)
+		{
+			for (auto fv = mesh_.fv_iter(Mesh::FaceHandle(region[i])); fv.is_valid(); ++fv)
+			{
+				for (auto vf = mesh_.vf_iter(*fv); vf.is_valid(); ++vf)
+				{
+					if (in_region.insert((*vf).idx()).second)
+						region.push_back((*vf).idx());
+				}
+			}
+		}
+		ring_begin = ring_end;
+	}
+
+	// local numbering, vertices shared with the rest of the mesh are pinned
+	std::unordered_map<int, int> local;
+	std::vector<int> vertices, faces;
+	faces.reserve(3 * region.size());
+	for (size_t i = 0; i < region.size(); i++)
+	{
+		for (auto fv = mesh_.fv_iter(Mesh::FaceHandle(region[i])); fv.is_valid(); ++fv)
+		{
+			auto it = local.insert(std::make_pair((*fv).idx(), (int)vertices.size()));
+			if (it.second)
+				vertices.push_back((*fv).idx());
+			faces.push_back(it.first->second);
+		}
+	}
+
+	// the last result, from the buffer if the mesh was not written
+	bool buffer = (int)texcoords_.size() == (int)mesh_.n_vertices();
+	int n = (int)vertices.size();
+	std::vector<Mesh::Point> points(n);
+	std::vector<double> x(2 * n);
+	std::vector<unsigned char> locked(2 * n, 0);
+	int nb_locked = 0;
+	for (int i = 0; i < n; i++)
+	{
+		Mesh::VertexHandle vh(vertices[i]);
+		points[i] = mesh_.point(vh);
+		const Vec2f& tc = buffer ? texcoords_[vertices[i]] : mesh_.texcoord2D(vh);
+		x[2 * i] = tc[0];
+		x[2 * i + 1] = tc[1];
+		for (auto vf = mesh_.vf_iter(vh); vf.is_valid(); ++vf)
+		{
+			if (!in_region.count((*vf).idx()))
+			{
+				locked[2 * i] = locked[2 * i + 1] = 1;
+				nb_locked++;
+				break;
+			}
+		}
+	}
+	if (nb_locked < 2)
+		return solve();
+
+	double t1 = omp_get_wtime();
+	stage("setup_LSCM");
+	LSCMSystem system;
+	system.assemble(&points[0], n, faces);
+	double t2 = omp_get_wtime();
+	stage("solve");
+	used_iterations_ = system.solve_cg(x, locked, 5 * n, tolerance(), progress_);
+	double t3 = omp_get_wtime();
+	solver_time_ = t3 - t2;
+	used_cache_ = false;
+	stage("get_result");
+	if (progress_ && progress_->cancelled())
+	{
+		stage(NULL);
+		return false;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		if (locked[2 * i])
+			continue;
+		Vec2f tc((float)x[2 * i], (float)x[2 * i + 1]);
+		if (buffer)
+			texcoords_[vertices[i]] = tc;
+		if (write_mesh_ || !buffer)
+			mesh_.set_texcoord2D(Mesh::VertexHandle(vertices[i]), tc);
+	}
+
+	timings_.setup = t1 - t0;
+	timings_.assemble = t2 - t1;
+	timings_.solve = t3 - t2;
+	timings_.result = omp_get_wtime() - t3;
+	stage(NULL);
+	if (telemetry_)
+	{
+		telemetry_->set_counter("vertices", n);
+		telemetry_->set_counter("faces", (double)faces.size() / 3);
+		telemetry_->set_counter("iterations", used_iterations_);
+	}
+	return true;
+}
+
+// Same stopping rule as the OpenNL CG path, and like OpenNL
+// reaching the iteration cap is not reported as a failure
+bool LSCMSolver::solve_parallel_cg()
+{
+	int nb_vertices = mesh_.n_vertices();
+
+	std::vector<unsigned char> locked(2 * nb_vertices, 0);
+	for (int i = 0; i < 2; i++)
+		locked[2 * lock_[i]] = locked[2 * lock_[i] + 1] = 1;
+
+	double t0 = omp_get_wtime();
+	used_iterations_ = system_.solve_cg(x_, locked, 5 * nb_vertices, tolerance(), progress_);
+	solver_time_ = omp_get_wtime() - t0;
+
+	return true;
+}
+
+// The normal equations of LSCM are symmetric positive definite, so the
+// direct backends factor them with a symmetric fill-reducing ordering.
+void LSCMSolver::setup_solver(int nb_vertices)
+{
+	switch (solver_type_)
+	{
+	case SOLVER_CHOLMOD:
+		if (nlInitExtension("CHOLMOD"))
+		{
+			nlSolverParameteri(NL_SOLVER, NL_CHOLMOD_EXT);
+			return;
+		}
+		std::cerr << "CHOLMOD extension not available, trying SuperLU" << std::endl;
+		// fall through
+	case SOLVER_SUPERLU:
+		if (nlInitExtension("SUPERLU"))
+		{
+			nlSolverParameteri(NL_SOLVER, NL_SYMMETRIC_SUPERLU_EXT);
+			return;
+		}
+		std::cerr << "SuperLU extension not available, using CG" << std::endl;
+		// fall through
+	case SOLVER_CG:
+	default:
+		nlSolverParameteri(NL_SOLVER, NL_CG);
+		nlSolverParameteri(NL_PRECONDITIONER, NL_PRECOND_JACOBI);
+		nlSolverParameteri(NL_MAX_ITERATIONS, 5 * nb_vertices);
+		nlSolverParameterd(NL_THRESHOLD, tolerance());
+		break;
+	}
+}
+
+void LSCMSolver::update_bbox()
+{
+	const Mesh::Point* points = mesh_.points();
+	int nb_vertices = mesh_.n_vertices();
+
+	bbMin = bbMax = points[0];
+	for (int i = 1; i < nb_vertices; i++)
+	{
+		bbMin.minimize(points[i]);
+		bbMax.maximize(points[i]);
+	}
+}
+
+void LSCMSolver::collect_faces()
+{
+	int nb_faces = mesh_.n_faces();
+	if (indices_ && (int)indices_->size() == 3 * nb_faces)
+	{
+		faces_.assign(indices_->begin(), indices_->end());
+		return;
+	}
+
+	faces_.clear();
+	faces_.reserve(3 * nb_faces);
+
+	auto f_it(mesh_.faces_begin());
+	auto f_end(mesh_.faces_end());
+	for (; f_it != f_end; f_it++)
+	{
+		auto fv = mesh_.fv_begin(*f_it);
+		for (int i = 0; i < 3; i++, fv++)
+			faces_.push_back((*fv).idx());
+	}
+}
+
+// Choose an initial solution, and lock two vertices
+void LSCMSolver::init_slover()
+{
+	// Get bbox
+	Vec3f bAxis = bbMax - bbMin;
+
+	// Get the Projection dirction
+	int d1 ,d2, d3, i;
+	d1 = d2 = d3 = 0;
+	for (i = 1; i < 3; i++)
+	{
+		if (bAxis[i] > bAxis[d1])
+			d1 = i;
+		if (bAxis[i] < bAxis[d3])
+			d3 = i;
+	}
+	for (d2 = 0; d2 < 3; d2++)
+	{
+		if (d2 != d1 && d2 != d3)
+			break;
+	}
+
+	// Project vertices
+	const Mesh::Point* points = mesh_.points();
+	int nb_vertices = mesh_.n_vertices();
+	x_.resize(2 * nb_vertices);
+	float u1 = -1.0e30, u2 = 1.0e30;
+	int lock1 = 0, lock2 = 0;
+	for (int idx = 0; idx < nb_vertices; idx++)
+	{
+		float u = points[idx][d1];
+		float v = points[idx][d2];
+
+		// set initial solution
+		x_[2 * idx] = u;
+		x_[2 * idx + 1] = v;
+
+		if (u > u1)
+		{
+			lock1 = idx;
+			u1 = u;
+		}
+		if (u < u2)
+		{
+			lock2 = idx;
+			u2 = u;
+		}
+	}
+
+	// set locked variables: the caller's pins, else the ends of the
+	// boundary diameter, else the extremes of the projection
+	int pins[2] = { pins_[0], pins_[1] };
+	bool valid = pins[0] >= 0 && pins[0] < nb_vertices &&
+		pins[1] >= 0 && pins[1] < nb_vertices && pins[0] != pins[1];
+	if (!valid && (pins_[0] >= 0 || pins_[1] >= 0))
+		std::cerr << "LSCMSolver: invalid pins " << pins_[0] << ", " << pins_[1] << "\n";
+	if (!valid)
+		valid = select_pins(points, nb_vertices, faces_, pins) && pins_separated(points, x_, pins);
+	if (!valid)
+	{
+		pins[0] = lock1;
+		pins[1] = lock2;
+	}
+	lock_[0] = pins[0];
+	lock_[1] = pins[1];
+}
+
+// Previous solution as initial guess, same locked vertices
+void LSCMSolver::init_from_cache(const LSCMCache::Entry& _entry)
+{
+	x_ = _entry.solution;
+	lock_[0] = _entry.lock[0];
+	lock_[1] = _entry.lock[1];
+}
+
+// LSCM on a coarsened mesh is a far better start than the axis
+// projection, the fine solve then only removes local error
+void LSCMSolver::init_multilevel()
+{
+	MeshHierarchy hierarchy;
+	hierarchy.build(mesh_.points(), mesh_.n_vertices(), faces_, lock_);
+	if (hierarchy.n_levels() > 0)
+		hierarchy.solve(x_);
+}
+
+// A cache hit of the same kind (same reordering, rows) reuses the
+// ordering and the pattern of the cached system, then only the
+// points are permuted and the values computed
+void LSCMSolver::setup_LSCM(const LSCMCache::Entry* _entry)
+{
+	// OpenNL reads the double rows
+	LSCMSystem::Storage storage = LSCMSystem::STORAGE_DOUBLE;
+	if (solver_type_ == SOLVER_MATRIX_FREE_CG)
+		storage = LSCMSystem::STORAGE_MATRIX_FREE;
+	bool cached_ordering = _entry && _entry->reordered && reorder_;
+	bool cached_pattern = _entry && _entry->pattern && _entry->reordered == reorder_ &&
+		storage == LSCMSystem::STORAGE_DOUBLE;
+
+	const Mesh::Point* points = mesh_.points();
+	const std::vector<int>* faces = &faces_;
+	std::vector<Mesh::Point> ordered_points;
+	std::vector<int> ordered_faces;
+	if (reorder_)
+	{
+		if (cached_ordering)
+			ordering_ = _entry->ordering;
+		else
+			ordering_.build(faces_, mesh_.n_vertices());
+		ordering_.apply_points(points, ordered_points);
+		if (!cached_pattern)
+			ordering_.apply_faces(faces_, ordered_faces);
+		ordering_.to_new(x_);
+		for (int i = 0; i < 2; i++)
+			lock_[i] = ordering_.rank()[lock_[i]];
+		points = &ordered_points[0];
+		faces = &ordered_faces;
+	}
+
+	if (cached_pattern)
+		system_.refill(points, mesh_.n_vertices(), _entry->pattern);
+	else
+		system_.assemble(points, mesh_.n_vertices(), *faces, storage);
+}
+
+// solution and pins back in the mesh order
+void LSCMSolver::restore_order()
+{
+	if (!reorder_)
+		return;
+	ordering_.to_old(x_);
+	for (int i = 0; i < 2; i++)
+		lock_[i] = ordering_.order()[lock_[i]];
+}
+
+void LSCMSolver::update_cache()
+{
+	LSCMCache::Entry& entry = cache_->insert(faces_, mesh_.n_vertices());
+	entry.lock[0] = lock_[0];
+	entry.lock[1] = lock_[1];
+	entry.solution = x_;
+
+	// a matrix free solve keeps the rows of an earlier one
+	if (system_.pattern() || entry.reordered != reorder_)
+		entry.pattern = system_.pattern();
+	entry.reordered = reorder_;
+	entry.ordering = reorder_ ? ordering_ : MeshOrdering();
+}
+
+void LSCMSolver::get_result()
+{
+	int nb_vertices = mesh_.n_vertices();
+
+	Vec2f tc1, tc2;
+	tc1[0] = tc2[0] = x_[0];
+	tc1[1] = tc2[1] = x_[1];
+	for (int i = 0; i < nb_vertices; i++)
+	{
+		float u = x_[2 * i];
+		float v = x_[2 * i + 1];
+		if (u < tc1[0])tc1[0] = u;
+		if (u > tc2[0])tc2[0] = u;
+		if (v < tc1[1])tc1[1] = v;
+		if (v > tc2[1])tc2[1] = v;
+	}
+
+	// Normalize
+	double dx = tc2[0] - tc1[0];
+	double dy = tc2[1] - tc1[1];
+	if (dy > dx) dx = dy;
+
+	// flat buffer, every thread writes its own vertices
+	texcoords_.resize(nb_vertices);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < nb_vertices; i++)
+	{
+		Vec2f tc((float)x_[2 * i], (float)x_[2 * i + 1]);
+		tc[0] = (tc[0] - tc1[0]) / dx;
+		tc[1] = (tc[1] - tc1[1]) / dx;
+		texcoords_[i] = tc;
+	}
+
+	if (write_mesh_)
+	{
+#pragma omp parallel for schedule(static)
+		for (int i = 0; i < nb_vertices; i++)
+			mesh_.set_texcoord2D(Mesh::VertexHandle(i), texcoords_[i]);
+	}
+}
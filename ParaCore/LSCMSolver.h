@@ -0,0 +1,157 @@
+#pragma once
+#include "MeshTypes.h"
+#include "LSCMCache.h"
+#include "LSCMSystem.h"
+#include "MeshOrdering.h"
+#include "SolverProgress.h"
+#include "Telemetry.h"
+
+/// Least Squares Conformal Maps, independent of any GL/GLUT state.
+/// The solution, normalized to [0,1]^2, is kept in texcoords() and,
+/// unless set_write_mesh(false), copied to the vertex texcoords of the
+/// mesh.
+class LSCMSolver
+{
+public:
+	/// linear solver backend
+	enum SolverType
+	{
+		SOLVER_CG,       ///< OpenNL conjugate gradient, Jacobi preconditioner
+		SOLVER_SUPERLU,  ///< OpenNL SuperLU extension, symmetric fill-reducing ordering
+		SOLVER_CHOLMOD,  ///< OpenNL CHOLMOD extension, supernodal Cholesky
+		SOLVER_PARALLEL_CG, ///< multithreaded Jacobi CG on the CSR system, no OpenNL
+		SOLVER_MATRIX_FREE_CG ///< SOLVER_PARALLEL_CG without a stored matrix, for huge meshes
+	};
+
+	/// wall time (s) of the stages of a solve
+	struct Timings
+	{
+		double setup;     ///< face list, pins and initial guess
+		double assemble;  ///< LSCM system
+		double solve;     ///< linear solve, including the OpenNL setup
+		double result;    ///< normalized texcoords, copied to the mesh
+	};
+
+public:
+	LSCMSolver(Mesh& _mesh);
+	~LSCMSolver();
+
+	/// select the solver backend, direct solvers fall back to CG
+	/// when OpenNL was built without the extension. OpenNL has a single
+	/// context per process, so its backends solve one mesh at a time
+	/// across threads, the parallel CG backends run concurrently.
+	void set_solver(SolverType _type) { solver_type_ = _type; }
+	SolverType solver() const { return solver_type_; }
+
+	/// share pins, solutions, the vertex ordering and the sparsity
+	/// pattern with meshes of the same connectivity, the cache must
+	/// outlive the solve (NULL disables caching)
+	void set_cache(LSCMCache* _cache) { cache_ = _cache; }
+
+	/// replace the axis projection initial guess by a coarse-to-fine
+	/// solve on a mesh hierarchy (ignored on cache hits)
+	void set_multilevel(bool _b) { multilevel_ = _b; }
+	bool multilevel() const { return multilevel_; }
+
+	/// The mesh faces in order as a flat triangle list (3 vertex indices
+	/// per face, such as the index array of a viewer), used instead of
+	/// walking the halfedges. Ignored unless it has 3 indices per face,
+	/// it must outlive the solve (NULL walks the mesh).
+	void set_faces(const std::vector<unsigned int>* _indices) { indices_ = _indices; }
+
+	/// renumber vertices and faces for locality (MeshOrdering) before
+	/// the system is assembled, the texcoords keep the mesh order
+	void set_reorder(bool _b) { reorder_ = _b; }
+	bool reorder() const { return reorder_; }
+
+	/// Vertices pinned to their initial (u,v), which fixes the
+	/// similarity of the map. By default (-1) they are picked on the
+	/// boundary (see PinSelection). Ignored on cache hits.
+	void set_pins(int _v0, int _v1) { pins_[0] = _v0; pins_[1] = _v1; }
+
+	/// report iterations and allow cancellation (NULL disables it).
+	/// Only the parallel CG backends stop mid-solve, on the criteria
+	/// of _progress, and stream their residuals to its callback. The
+	/// OpenNL backends only use its tolerance and are checked before
+	/// and after solving.
+	void set_progress(SolverProgress* _progress) { progress_ = _progress; }
+
+	/// time the stages of solve() (bbox, collect_faces, init_slover,
+	/// setup_LSCM, solve, get_result) and count vertices, faces,
+	/// nonzeros and iterations into _telemetry (NULL disables it)
+	void set_telemetry(Telemetry* _telemetry) { telemetry_ = _telemetry; }
+
+	/// copy the result to the vertex texcoords of the mesh (default),
+	/// callers reading texcoords() only can skip the copy
+	void set_write_mesh(bool _b) { write_mesh_ = _b; }
+	bool write_mesh() const { return write_mesh_; }
+
+	/// run the parameterization
+	bool solve();
+
+	/// After a solve, re-solve only around the faces in _faces (edited
+	/// since) with the texcoords around them held fixed: the edit grown
+	/// by _rings rings of faces is solved, the vertices it shares with
+	/// the other faces are pinned. Only the region is visited, so the
+	/// cost follows the edit and not the mesh. Runs solve() when the
+	/// region leaves fewer than two vertices to pin. Its stages are
+	/// collect_faces (the region), setup_LSCM, solve and get_result.
+	bool solve_region(const std::vector<int>& _faces, int _rings = 3);
+
+	/// statistics of the last solve
+	double solver_time() const { return solver_time_; }
+	int used_iterations() const { return used_iterations_; }
+	bool used_cache() const { return used_cache_; }
+	const Timings& timings() const { return timings_; }
+
+	/// normalized (u,v) per vertex of the last solve, contiguous
+	const std::vector<Vec2f>& texcoords() const { return texcoords_; }
+
+private:
+	void update_bbox();
+	void setup_solver(int nb_vertices);
+	void collect_faces();
+	void init_slover();
+	void init_from_cache(const LSCMCache::Entry& _entry);
+	void init_multilevel();
+	void setup_LSCM(const LSCMCache::Entry* _entry);
+	void restore_order();
+	bool solve_opennl();
+	bool solve_parallel_cg();
+	void update_cache();
+	void get_result();
+	void stage(const char* _name);
+	double tolerance() const;
+
+private:
+	Mesh& mesh_;
+	Mesh::Point bbMin, bbMax;
+	SolverType solver_type_;
+
+	// flat face list, 3 vertex indices per face
+	const std::vector<unsigned int>* indices_;
+	std::vector<int> faces_;
+	LSCMSystem system_;
+
+	// x_ and lock_ are in the ordering's numbering from setup_LSCM()
+	// until restore_order()
+	bool reorder_;
+	MeshOrdering ordering_;
+
+	// unknowns (u,v) per vertex, initial guess then solution
+	std::vector<double> x_;
+	std::vector<Vec2f> texcoords_;
+	int lock_[2];
+	int pins_[2];
+
+	LSCMCache* cache_;
+	bool multilevel_;
+	SolverProgress* progress_;
+	Telemetry* telemetry_;
+	bool write_mesh_;
+
+	double solver_time_;
+	int used_iterations_;
+	bool used_cache_;
+	Timings timings_;
+};
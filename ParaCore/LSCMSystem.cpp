@@ -0,0 +1,485 @@
+#include "LSCMSystem.h"
+#include "TriangleKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+
+LSCMSystem::LSCMSystem() :
+storage_(STORAGE_DOUBLE), n_rows_(0), n_cols_(0)
+{
+}
+
+// LSCM equation, geometric form :
+// (Z1 - Z0)(U2 - U0) = (Z2 - Z0)(U1 - U0)
+// Where Uk = uk + i.vk is the complex number
+//                       corresponding to (u,v) coords
+//       Zk = xk + i.yk is the complex number
+//                       corresponding to local (x,y) coords
+void LSCMSystem::assemble(const Mesh::Point* _points, int _n_vertices,
+	const std::vector<int>& _faces, Storage _storage)
+{
+	int nb_faces = (int)_faces.size() / 3;
+	storage_ = _storage;
+	n_rows_ = 2 * nb_faces;
+	n_cols_ = 2 * _n_vertices;
+
+	// only the arrays of this storage are kept
+	bool free = _storage == STORAGE_MATRIX_FREE;
+	values_.resize(free ? 0 : NNZ_PER_ROW * n_rows_);
+	coefs_.resize(free ? 3 * nb_faces : 0);
+	if (free)
+		faces_ = _faces;
+	else
+		faces_.clear();
+	values_.shrink_to_fit();
+	coefs_.shrink_to_fit();
+	faces_.shrink_to_fit();
+
+	if (free)
+	{
+		pattern_.reset();
+		build_incidence(_n_vertices);
+	}
+	else
+	{
+		std::vector<int>().swap(vertex_start_);
+		std::vector<int>().swap(vertex_corners_);
+
+		std::shared_ptr<Pattern> pattern = std::make_shared<Pattern>();
+		pattern->col_idx.resize(NNZ_PER_ROW * n_rows_);
+#pragma omp parallel for schedule(static)
+		for (int f = 0; f < nb_faces; f++)
+		{
+			// Note  : 2*id + 0 --> u
+			//         2*id + 1 --> v
+			const int* id = &_faces[3 * f];
+			int* col = &pattern->col_idx[2 * NNZ_PER_ROW * f];
+
+			// Real part
+			col[0] = 2 * id[0];
+			col[1] = 2 * id[0] + 1;
+			col[2] = 2 * id[1];
+			col[3] = 2 * id[1] + 1;
+			col[4] = 2 * id[2];
+
+			// Imaginary part
+			col[5] = 2 * id[0];
+			col[6] = 2 * id[0] + 1;
+			col[7] = 2 * id[1];
+			col[8] = 2 * id[1] + 1;
+			col[9] = 2 * id[2] + 1;
+		}
+		build_transpose(*pattern, n_cols_);
+		pattern_ = pattern;
+	}
+
+	fill_values(_points);
+}
+
+void LSCMSystem::refill(const Mesh::Point* _points, int _n_vertices, const PatternPtr& _pattern)
+{
+	storage_ = STORAGE_DOUBLE;
+	n_rows_ = (int)_pattern->col_idx.size() / NNZ_PER_ROW;
+	n_cols_ = 2 * _n_vertices;
+	pattern_ = _pattern;
+
+	values_.resize(NNZ_PER_ROW * n_rows_);
+	std::vector<float>().swap(coefs_);
+	std::vector<int>().swap(faces_);
+	std::vector<int>().swap(vertex_start_);
+	std::vector<int>().swap(vertex_corners_);
+
+	fill_values(_points);
+}
+
+// Each block gathers its triangle corners into structure-of-arrays
+// buffers, so that the local frames are computed 8 faces at a time.
+// The corners are read from the faces (matrix free) or the columns
+// of the real row, u0 u1 u2 at 0, 2, 4.
+void LSCMSystem::fill_values(const Mesh::Point* _points)
+{
+	bool free = storage_ == STORAGE_MATRIX_FREE;
+	int nb_faces = n_rows_ / 2;
+	int nb_blocks = (nb_faces + FACE_BLOCK - 1) / FACE_BLOCK;
+#pragma omp parallel for schedule(static)
+	for (int blk = 0; blk < nb_blocks; blk++)
+	{
+		int f0 = blk * FACE_BLOCK;
+		int n = std::min((int)FACE_BLOCK, nb_faces - f0);
+
+		float px[3][FACE_BLOCK], py[3][FACE_BLOCK], pz[3][FACE_BLOCK];
+		for (int i = 0; i < n; i++)
+		{
+			int f = f0 + i;
+			const int* col = free ? NULL : &pattern_->col_idx[2 * NNZ_PER_ROW * f];
+			for (int k = 0; k < 3; k++)
+			{
+				int v = free ? faces_[3 * f + k] : col[2 * k] / 2;
+				const Mesh::Point& p = _points[v];
+				px[k][i] = p[0];
+				py[k][i] = p[1];
+				pz[k][i] = p[2];
+			}
+		}
+
+		TriangleCorners t = { { px[0], px[1], px[2] },
+		                      { py[0], py[1], py[2] },
+		                      { pz[0], pz[1], pz[2] } };
+		float fa[FACE_BLOCK], fc[FACE_BLOCK], fd[FACE_BLOCK];
+		project_triangles(t, n, fa, fc, fd);
+
+		if (free)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				float* coef = &coefs_[3 * (f0 + i)];
+				coef[0] = fa[i];
+				coef[1] = fc[i];
+				coef[2] = fd[i];
+			}
+			continue;
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			// z0 = (0,0), z1 = (a,b), z2 = (c,d) with b = 0
+			double a = fa[i];
+			double b = 0.0;
+			double c = fc[i];
+			double d = fd[i];
+
+			double* val = &values_[2 * NNZ_PER_ROW * (f0 + i)];
+
+			// Real part
+			val[0] = -a + c;
+			val[1] = b - d;
+			val[2] = -c;
+			val[3] = d;
+			val[4] = a;
+
+			// Imaginary part
+			val[5] = -b + d;
+			val[6] = -a + c;
+			val[7] = -d;
+			val[8] = -c;
+			val[9] = a;
+		}
+	}
+}
+
+// Counting sort of the entries by column, so that A^T x can be
+// computed one column per thread without write conflicts
+void LSCMSystem::build_transpose(Pattern& _pattern, int _n_cols)
+{
+	const std::vector<int>& col_idx = _pattern.col_idx;
+	std::vector<int>& col_start = _pattern.col_start;
+	int nz = (int)col_idx.size();
+	col_start.assign(_n_cols + 1, 0);
+	for (int k = 0; k < nz; k++)
+		col_start[col_idx[k] + 1]++;
+	for (int j = 0; j < _n_cols; j++)
+		col_start[j + 1] += col_start[j];
+
+	_pattern.col_entries.resize(nz);
+	std::vector<int> fill(col_start.begin(), col_start.end() - 1);
+	for (int k = 0; k < nz; k++)
+		_pattern.col_entries[fill[col_idx[k]]++] = k;
+}
+
+// Same for the face corners by vertex, A^T x is then gathered one
+// vertex (u and v) per thread
+void LSCMSystem::build_incidence(int _n_vertices)
+{
+	int nc = (int)faces_.size();
+	vertex_start_.assign(_n_vertices + 1, 0);
+	for (int c = 0; c < nc; c++)
+		vertex_start_[faces_[c] + 1]++;
+	for (int v = 0; v < _n_vertices; v++)
+		vertex_start_[v + 1] += vertex_start_[v];
+
+	vertex_corners_.resize(nc);
+	std::vector<int> fill(vertex_start_.begin(), vertex_start_.end() - 1);
+	for (int c = 0; c < nc; c++)
+		vertex_corners_[fill[faces_[c]]++] = c;
+}
+
+void LSCMSystem::multiply(const double* x, double* y) const
+{
+	if (storage_ == STORAGE_MATRIX_FREE)
+	{
+		multiply_free(x, y);
+		return;
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int r = 0; r < n_rows_; r++)
+	{
+		const int* col = row_cols(r);
+		const double* val = row_values(r);
+		double s = 0.0;
+		for (int k = 0; k < NNZ_PER_ROW; k++)
+			s += val[k] * x[col[k]];
+		y[r] = s;
+	}
+}
+
+void LSCMSystem::multiply_transpose(const double* x, double* y) const
+{
+	if (storage_ == STORAGE_MATRIX_FREE)
+	{
+		multiply_transpose_free(x, y);
+		return;
+	}
+
+	const Pattern& pattern = *pattern_;
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < n_cols_; j++)
+	{
+		double s = 0.0;
+		for (int e = pattern.col_start[j]; e < pattern.col_start[j + 1]; e++)
+		{
+			int k = pattern.col_entries[e];
+			s += values_[k] * x[k / NNZ_PER_ROW];
+		}
+		y[j] = s;
+	}
+}
+
+// Rows of face f, with the unknowns of its corners 0, 1, 2:
+//   real: (c-a) u0 -     d v0 - c u1 + d v1 + a u2
+//   imag:     d u0 + (c-a) v0 - d u1 - c v1 + a v2
+void LSCMSystem::multiply_free(const double* x, double* y) const
+{
+	int nb_faces = (int)coefs_.size() / 3;
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < nb_faces; f++)
+	{
+		const float* coef = &coefs_[3 * f];
+		const int* id = &faces_[3 * f];
+		double a = coef[0], c = coef[1], d = coef[2];
+		double u0 = x[2 * id[0]], v0 = x[2 * id[0] + 1];
+		double u1 = x[2 * id[1]], v1 = x[2 * id[1] + 1];
+		double u2 = x[2 * id[2]], v2 = x[2 * id[2] + 1];
+		y[2 * f] = (c - a) * u0 - d * v0 - c * u1 + d * v1 + a * u2;
+		y[2 * f + 1] = d * u0 + (c - a) * v0 - d * u1 - c * v1 + a * v2;
+	}
+}
+
+// The columns of the rows above, corner by corner
+void LSCMSystem::multiply_transpose_free(const double* x, double* y) const
+{
+	int nb_vertices = n_cols_ / 2;
+#pragma omp parallel for schedule(static)
+	for (int v = 0; v < nb_vertices; v++)
+	{
+		double su = 0.0, sv = 0.0;
+		for (int e = vertex_start_[v]; e < vertex_start_[v + 1]; e++)
+		{
+			int corner = vertex_corners_[e];
+			int f = corner / 3;
+			const float* coef = &coefs_[3 * f];
+			double a = coef[0], c = coef[1], d = coef[2];
+			double re = x[2 * f], im = x[2 * f + 1];
+			switch (corner - 3 * f)
+			{
+			case 0:
+				su += (c - a) * re + d * im;
+				sv += (c - a) * im - d * re;
+				break;
+			case 1:
+				su -= c * re + d * im;
+				sv += d * re - c * im;
+				break;
+			default:
+				su += a * re;
+				sv += a * im;
+				break;
+			}
+		}
+		y[2 * v] = su;
+		y[2 * v + 1] = sv;
+	}
+}
+
+void LSCMSystem::diagonal(double* _d) const
+{
+	if (storage_ == STORAGE_MATRIX_FREE)
+	{
+		int nb_vertices = n_cols_ / 2;
+#pragma omp parallel for schedule(static)
+		for (int v = 0; v < nb_vertices; v++)
+		{
+			// u and v of a corner see the same two coefficients
+			double s = 0.0;
+			for (int e = vertex_start_[v]; e < vertex_start_[v + 1]; e++)
+			{
+				int corner = vertex_corners_[e];
+				const float* coef = &coefs_[3 * (corner / 3)];
+				double a = coef[0], c = coef[1], d = coef[2];
+				int k = corner % 3;
+				s += k == 0 ? (c - a) * (c - a) + d * d : k == 1 ? c * c + d * d : a * a;
+			}
+			_d[2 * v] = _d[2 * v + 1] = s;
+		}
+		return;
+	}
+
+	const Pattern& pattern = *pattern_;
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < n_cols_; j++)
+	{
+		double s = 0.0;
+		for (int e = pattern.col_start[j]; e < pattern.col_start[j + 1]; e++)
+			s += values_[pattern.col_entries[e]] * values_[pattern.col_entries[e]];
+		_d[j] = s;
+	}
+}
+
+int LSCMSystem::solve_cg(std::vector<double>& _x, const std::vector<unsigned char>& _locked,
+	int _max_iter, double _threshold, SolverProgress* _progress) const
+{
+	int n = n_cols_;
+	std::vector<double> t(n_rows_), r(n), z(n), p(n), q(n), inv_diag(n), xl(n);
+
+	// Jacobi preconditioner, diagonal of A^T A restricted to free variables
+	diagonal(&inv_diag[0]);
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < n; j++)
+	{
+		double s = inv_diag[j];
+		inv_diag[j] = (_locked[j] || s == 0.0) ? 0.0 : 1.0 / s;
+		xl[j] = _locked[j] ? _x[j] : 0.0;
+	}
+
+	// right hand side b = -A^T A x_locked, only used for the threshold
+	multiply(&xl[0], &t[0]);
+	multiply_transpose(&t[0], &q[0]);
+	double bb = 0.0;
+#pragma omp parallel for reduction(+:bb)
+	for (int j = 0; j < n; j++)
+	{
+		if (!_locked[j])
+			bb += q[j] * q[j];
+	}
+
+	// r = b - A^T A x_free = -A^T A x
+	multiply(&_x[0], &t[0]);
+	multiply_transpose(&t[0], &r[0]);
+	double rz = 0.0, rr = 0.0;
+#pragma omp parallel for reduction(+:rz,rr)
+	for (int j = 0; j < n; j++)
+	{
+		r[j] = _locked[j] ? 0.0 : -r[j];
+		z[j] = inv_diag[j] * r[j];
+		p[j] = z[j];
+		rz += r[j] * z[j];
+		rr += r[j] * r[j];
+	}
+
+	// the (u,v) change of an iteration is measured against the
+	// spread of the pinned values, which sets the scale of the map
+	double t0 = omp_get_wtime();
+	double scale = 0.0;
+	int nb_free = 0;
+	if (_progress)
+	{
+		double lo[2] = { 1e300, 1e300 }, hi[2] = { -1e300, -1e300 };
+		for (int j = 0; j < n; j++)
+		{
+			if (!_locked[j])
+			{
+				nb_free++;
+				continue;
+			}
+			lo[j & 1] = std::min(lo[j & 1], _x[j]);
+			hi[j & 1] = std::max(hi[j & 1], _x[j]);
+		}
+		scale = std::max(hi[0] - lo[0], hi[1] - lo[1]);
+		if (scale <= 0.0)
+			scale = 1.0;
+	}
+
+	double err = _threshold * _threshold * bb;
+	int it = 0;
+	SolverProgress::Stop stop = SolverProgress::STOP_ITERATIONS;
+	while (it < _max_iter)
+	{
+		if (rr <= err)
+		{
+			stop = SolverProgress::STOP_RESIDUAL;
+			break;
+		}
+
+		multiply(&p[0], &t[0]);
+		multiply_transpose(&t[0], &q[0]);
+
+		double pq = 0.0, pp = 0.0;
+#pragma omp parallel for reduction(+:pq,pp)
+		for (int j = 0; j < n; j++)
+		{
+			if (_locked[j])
+				q[j] = 0.0;
+			pq += p[j] * q[j];
+			pp += p[j] * p[j];
+		}
+		if (pq <= 0.0)
+		{
+			stop = SolverProgress::STOP_RESIDUAL;
+			break;
+		}
+		double alpha = rz / pq;
+
+		double rz_new = 0.0;
+		rr = 0.0;
+#pragma omp parallel for reduction(+:rz_new,rr)
+		for (int j = 0; j < n; j++)
+		{
+			_x[j] += alpha * p[j];
+			r[j] -= alpha * q[j];
+			z[j] = inv_diag[j] * r[j];
+			rz_new += r[j] * z[j];
+			rr += r[j] * r[j];
+		}
+
+		double beta = rz_new / rz;
+		rz = rz_new;
+#pragma omp parallel for schedule(static)
+		for (int j = 0; j < n; j++)
+			p[j] = z[j] + beta * p[j];
+
+		++it;
+
+		if (_progress)
+		{
+			double residual = bb > 0.0 ? std::sqrt(rr / bb) : 0.0;
+			double change = scale > 0.0 && nb_free > 0 ?
+				std::fabs(alpha) * std::sqrt(pp / nb_free) / scale : 0.0;
+			_progress->set_iteration(it, residual);
+			if (_progress->callback())
+				_progress->callback()(it, residual, change);
+
+			if (_progress->cancelled())
+			{
+				stop = SolverProgress::STOP_CANCELLED;
+				break;
+			}
+			if (scale > 0.0 && change < _progress->min_change())
+			{
+				stop = SolverProgress::STOP_CHANGE;
+				break;
+			}
+			if (_progress->time_limit() > 0.0 && omp_get_wtime() - t0 > _progress->time_limit())
+			{
+				stop = SolverProgress::STOP_TIME;
+				break;
+			}
+		}
+	}
+	if (it == _max_iter && rr <= err)
+		stop = SolverProgress::STOP_RESIDUAL;
+
+	if (_progress)
+		_progress->set_stop(stop);
+	return it;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "MeshTypes.h"
+#include "SolverProgress.h"
+#include <vector>
+#include <memory>
+
+/// The LSCM least squares system A x = 0 in compressed row storage.
+/// Every face contributes exactly two rows with five nonzeros, so the
+/// layout follows from the face count: row r owns the entries
+/// [5r, 5r+5), and faces are assembled in parallel without locking.
+/// Unknowns are interleaved, 2*idx --> u and 2*idx+1 --> v.
+///
+/// Matrix free, only a, c, d and the vertex indices of every face are
+/// kept and the rows are rebuilt whenever A or A^T is applied, a few
+/// times less memory than the rows for meshes too large for them.
+///
+/// The columns of the rows and their transpose only depend on the
+/// faces, they are kept in a Pattern that a later system of the same
+/// faces (see LSCMCache) reuses with refill(), which only computes
+/// the values.
+class LSCMSystem
+{
+public:
+	enum { NNZ_PER_ROW = 5 };
+
+	/// faces gathered into one structure-of-arrays block
+	enum { FACE_BLOCK = 64 };
+
+	/// how the matrix is kept
+	enum Storage
+	{
+		STORAGE_DOUBLE,      ///< rows with double entries
+		STORAGE_MATRIX_FREE  ///< a, c, d per face, no rows
+	};
+
+	/// Sparsity of the rows: the column of every entry, and the
+	/// entries of column j at entries[col_start[j] .. col_start[j+1])
+	struct Pattern
+	{
+		std::vector<int> col_idx;
+		std::vector<int> col_start;
+		std::vector<int> col_entries;
+	};
+	typedef std::shared_ptr<const Pattern> PatternPtr;
+
+public:
+	LSCMSystem();
+
+	/// fill the matrix from vertex positions and a flat face list
+	/// (3 vertex indices per face), in parallel blocks of faces
+	void assemble(const Mesh::Point* _points, int _n_vertices,
+		const std::vector<int>& _faces, Storage _storage = STORAGE_DOUBLE);
+
+	/// assemble() in STORAGE_DOUBLE on the pattern of an earlier
+	/// assemble() of the same faces, only the values are computed
+	void refill(const Mesh::Point* _points, int _n_vertices, const PatternPtr& _pattern);
+
+	/// pattern of the rows, NULL in STORAGE_MATRIX_FREE
+	const PatternPtr& pattern() const { return pattern_; }
+
+	int n_rows() const { return n_rows_; }
+	int n_cols() const { return n_cols_; }
+	int nnz() const { return pattern_ ? (int)pattern_->col_idx.size() : 0; }
+	Storage storage() const { return storage_; }
+
+	/// rows are only stored in STORAGE_DOUBLE
+	const int* row_cols(int _r) const { return &pattern_->col_idx[NNZ_PER_ROW * _r]; }
+	const double* row_values(int _r) const { return &values_[NNZ_PER_ROW * _r]; }
+
+	/// Jacobi preconditioned conjugate gradient on the normal equations
+	/// A^T A x = 0. Entries of _x flagged in _locked keep their value, the
+	/// others are solved for starting from their current value.
+	/// Returns the number of iterations. A _progress receives every
+	/// iteration, stops the solve once it is cancelled or one of its
+	/// criteria is met, and records why the solve stopped.
+	int solve_cg(std::vector<double>& _x, const std::vector<unsigned char>& _locked,
+		int _max_iter, double _threshold, SolverProgress* _progress = NULL) const;
+
+private:
+	void fill_values(const Mesh::Point* _points);
+	static void build_transpose(Pattern& _pattern, int _n_cols);
+	void build_incidence(int _n_vertices);
+
+	/// diagonal of A^T A
+	void diagonal(double* _d) const;
+
+	/// y = A x
+	void multiply(const double* x, double* y) const;
+	/// y = A^T x
+	void multiply_transpose(const double* x, double* y) const;
+	void multiply_free(const double* x, double* y) const;
+	void multiply_transpose_free(const double* x, double* y) const;
+
+private:
+	Storage storage_;
+	int n_rows_, n_cols_;
+	PatternPtr pattern_;
+	std::vector<double> values_;
+
+	// matrix free: a, c, d and the vertex indices of face f at 3f, the
+	// corners 3f+k of vertex v at
+	// vertex_corners_[vertex_start_[v] .. vertex_start_[v+1])
+	std::vector<float> coefs_;
+	std::vector<int> faces_;
+	std::vector<int> vertex_start_;
+	std::vector<int> vertex_corners_;
+};
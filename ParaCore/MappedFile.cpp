@@ -0,0 +1,168 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#  define NOMINMAX
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile() :
+data_(NULL), size_(0), writable_(false)
+#if defined(_WIN32)
+, file_(INVALID_HANDLE_VALUE), mapping_(NULL)
+#else
+, fd_(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const char* _filename)
+{
+	close();
+
+	file_ = CreateFileA(_filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file_ == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	size_ = (size_t)size.QuadPart;
+
+	mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping_)
+		data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	if (!data_)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::create(const char* _filename, size_t _size)
+{
+	close();
+	if (_size == 0)
+		return false;
+
+	file_ = CreateFileA(_filename, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+	if (file_ == INVALID_HANDLE_VALUE)
+		return false;
+	size_ = _size;
+
+	unsigned long long size = _size;
+	mapping_ = CreateFileMappingA(file_, NULL, PAGE_READWRITE,
+		(DWORD)(size >> 32), (DWORD)size, NULL);
+	if (mapping_)
+		data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, 0);
+	if (!data_)
+	{
+		close();
+		return false;
+	}
+	writable_ = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data_)
+		UnmapViewOfFile(data_);
+	if (mapping_)
+		CloseHandle(mapping_);
+	if (file_ != INVALID_HANDLE_VALUE)
+		CloseHandle(file_);
+	data_ = NULL;
+	size_ = 0;
+	writable_ = false;
+	mapping_ = NULL;
+	file_ = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char* _filename)
+{
+	close();
+
+	fd_ = ::open(_filename, O_RDONLY);
+	if (fd_ < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd_, &st) != 0 || st.st_size == 0)
+	{
+		close();
+		return false;
+	}
+	size_ = (size_t)st.st_size;
+
+	void* p = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+	if (p == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	data_ = (const char*)p;
+	madvise(p, size_, MADV_SEQUENTIAL);
+	return true;
+}
+
+bool MappedFile::create(const char* _filename, size_t _size)
+{
+	close();
+	if (_size == 0)
+		return false;
+
+	fd_ = ::open(_filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd_ < 0)
+		return false;
+	if (ftruncate(fd_, (off_t)_size) != 0)
+	{
+		close();
+		return false;
+	}
+	size_ = _size;
+
+	void* p = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+	if (p == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	data_ = (const char*)p;
+	writable_ = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data_)
+		munmap((void*)data_, size_);
+	if (fd_ >= 0)
+		::close(fd_);
+	data_ = NULL;
+	size_ = 0;
+	writable_ = false;
+	fd_ = -1;
+}
+
+#endif
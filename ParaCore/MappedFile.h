@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+
+/// Memory mapping of a whole file, read-only, or read-write for a new
+/// scratch file that create() sizes up front.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const char* _filename);
+	/// creates or truncates _filename to _size bytes, mapped writable
+	bool create(const char* _filename, size_t _size);
+	void close();
+
+	bool is_open() const { return data_ != NULL; }
+	const char* data() const { return data_; }
+	size_t size() const { return size_; }
+	/// NULL unless the file was created
+	char* writable() const { return writable_ ? (char*)data_ : NULL; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+private:
+	const char* data_;
+	size_t size_;
+	bool writable_;
+#if defined(_WIN32)
+	void* file_;
+	void* mapping_;
+#else
+	int fd_;
+#endif
+};
@@ -0,0 +1,220 @@
+#include "MeshHierarchy.h"
+#include "LSCMSystem.h"
+#include <cmath>
+
+
+void MeshHierarchy::build(const Mesh::Point* _points, int _n_vertices,
+	const std::vector<int>& _faces, const int _lock[2], int _min_vertices)
+{
+	// levels refer to their finer neighbor while being built,
+	// so the storage must not move
+	levels_.clear();
+	levels_.reserve(MAX_LEVELS);
+	lock_[0] = _lock[0];
+	lock_[1] = _lock[1];
+
+	const Mesh::Point* points = _points;
+	int n_vertices = _n_vertices;
+	const std::vector<int>* faces = &_faces;
+	const int* lock = _lock;
+
+	while (n_vertices > _min_vertices && n_levels() < MAX_LEVELS)
+	{
+		levels_.push_back(Level());
+		Level& coarse = levels_.back();
+		coarsen(points, n_vertices, *faces, lock, coarse);
+
+		// matching got stuck, more levels would not pay off, or the
+		// pins no longer constrain the coarse system
+		int n_coarse = (int)coarse.points.size();
+		if (n_coarse > 0.85 * n_vertices || coarse.faces.empty() ||
+			!pins_valid(coarse))
+		{
+			levels_.pop_back();
+			break;
+		}
+
+		points = &coarse.points[0];
+		n_vertices = n_coarse;
+		faces = &coarse.faces;
+		lock = coarse.lock;
+	}
+}
+
+// Greedy matching: every unmatched vertex collapses with its closest
+// unmatched neighbor, the merged vertex sits at the midpoint, or on
+// the pinned vertex if the pair contains one.
+void MeshHierarchy::coarsen(const Mesh::Point* _points, int _n_vertices,
+	const std::vector<int>& _faces, const int _lock[2], Level& _coarse)
+{
+	int nb_faces = (int)_faces.size() / 3;
+
+	// vertex adjacency from the face list (counting sort by vertex)
+	std::vector<int> start(_n_vertices + 1, 0);
+	for (int i = 0; i < 3 * nb_faces; i++)
+		start[_faces[i] + 1] += 2;
+	for (int v = 0; v < _n_vertices; v++)
+		start[v + 1] += start[v];
+	std::vector<int> adj(start[_n_vertices]);
+	std::vector<int> fill(start.begin(), start.end() - 1);
+	for (int f = 0; f < nb_faces; f++)
+	{
+		const int* id = &_faces[3 * f];
+		for (int k = 0; k < 3; k++)
+		{
+			int v = id[k];
+			adj[fill[v]++] = id[(k + 1) % 3];
+			adj[fill[v]++] = id[(k + 2) % 3];
+		}
+	}
+
+	std::vector<int>& parent = _coarse.parent;
+	parent.assign(_n_vertices, -1);
+	std::vector<int> count;
+	int n_coarse = 0;
+
+	for (int v = 0; v < _n_vertices; v++)
+	{
+		if (parent[v] >= 0)
+			continue;
+
+		int best = -1;
+		float best_d = 0.0f;
+		for (int e = start[v]; e < start[v + 1]; e++)
+		{
+			int w = adj[e];
+			if (w == v || parent[w] >= 0)
+				continue;
+			float d = (_points[w] - _points[v]).sqrnorm();
+			if (best < 0 || d < best_d)
+			{
+				best = w;
+				best_d = d;
+			}
+		}
+
+		parent[v] = n_coarse;
+		if (best >= 0)
+			parent[best] = n_coarse;
+		count.push_back(best >= 0 ? 2 : 1);
+		++n_coarse;
+	}
+
+	_coarse.points.assign(n_coarse, Mesh::Point(0, 0, 0));
+	for (int v = 0; v < _n_vertices; v++)
+		_coarse.points[parent[v]] += _points[v];
+	for (int c = 0; c < n_coarse; c++)
+		_coarse.points[c] /= (float)count[c];
+	for (int i = 0; i < 2; i++)
+	{
+		_coarse.lock[i] = parent[_lock[i]];
+		_coarse.points[_coarse.lock[i]] = _points[_lock[i]];
+	}
+
+	// faces that collapsed to an edge or a point are dropped
+	_coarse.faces.clear();
+	_coarse.faces.reserve(3 * nb_faces / 2);
+	for (int f = 0; f < nb_faces; f++)
+	{
+		int c0 = parent[_faces[3 * f]];
+		int c1 = parent[_faces[3 * f + 1]];
+		int c2 = parent[_faces[3 * f + 2]];
+		if (c0 == c1 || c1 == c2 || c2 == c0)
+			continue;
+		_coarse.faces.push_back(c0);
+		_coarse.faces.push_back(c1);
+		_coarse.faces.push_back(c2);
+	}
+}
+
+bool MeshHierarchy::pins_valid(const Level& _level)
+{
+	if (_level.lock[0] == _level.lock[1])
+		return false;
+
+	bool used[2] = { false, false };
+	for (size_t i = 0; i < _level.faces.size(); i++)
+	{
+		if (_level.faces[i] == _level.lock[0]) used[0] = true;
+		if (_level.faces[i] == _level.lock[1]) used[1] = true;
+	}
+	return used[0] && used[1];
+}
+
+void MeshHierarchy::solve(std::vector<double>& _x, int _smooth_iter) const
+{
+	int L = n_levels();
+	if (L == 0)
+		return;
+
+	// x[0] is the finest level, x[l] lives on levels_[l - 1]
+	std::vector< std::vector<double> > x(L + 1);
+
+	// restrict the initial guess down to the coarsest level
+	const std::vector<double>* fine = &_x;
+	for (int l = 1; l <= L; l++)
+	{
+		const Level& lv = levels_[l - 1];
+		int n = (int)lv.points.size();
+		std::vector<int> count(n, 0);
+		x[l].assign(2 * n, 0.0);
+		for (size_t v = 0; v < lv.parent.size(); v++)
+		{
+			int c = lv.parent[v];
+			x[l][2 * c] += (*fine)[2 * v];
+			x[l][2 * c + 1] += (*fine)[2 * v + 1];
+			count[c]++;
+		}
+		for (int c = 0; c < n; c++)
+		{
+			if (count[c] == 0)
+				continue;
+			x[l][2 * c] /= count[c];
+			x[l][2 * c + 1] /= count[c];
+		}
+
+		// pinned values are passed down unchanged
+		const int* fine_lock = l > 1 ? levels_[l - 2].lock : lock_;
+		for (int i = 0; i < 2; i++)
+		{
+			x[l][2 * lv.lock[i]] = (*fine)[2 * fine_lock[i]];
+			x[l][2 * lv.lock[i] + 1] = (*fine)[2 * fine_lock[i] + 1];
+		}
+		fine = &x[l];
+	}
+
+	// solve on the coarsest level, then prolongate and smooth upwards
+	for (int l = L; l >= 1; l--)
+	{
+		const Level& lv = levels_[l - 1];
+		int n = (int)lv.points.size();
+
+		std::vector<unsigned char> locked(2 * n, 0);
+		for (int i = 0; i < 2; i++)
+			locked[2 * lv.lock[i]] = locked[2 * lv.lock[i] + 1] = 1;
+
+		LSCMSystem system;
+		system.assemble(&lv.points[0], n, lv.faces);
+		system.solve_cg(x[l], locked, l == L ? 5 * n : _smooth_iter, 1e-10);
+
+		// a broken coarse level must not spoil the caller's guess
+		for (int i = 0; i < 2 * n; i++)
+		{
+			if (!(std::fabs(x[l][i]) < 1e30))
+				return;
+		}
+
+		// piecewise constant prolongation, locked entries are kept
+		std::vector<double>& xf = l > 1 ? x[l - 1] : _x;
+		const int* fine_lock = l > 1 ? levels_[l - 2].lock : lock_;
+		int n_fine = (int)lv.parent.size();
+		for (int v = 0; v < n_fine; v++)
+		{
+			if (v == fine_lock[0] || v == fine_lock[1])
+				continue;
+			int c = lv.parent[v];
+			xf[2 * v] = x[l][2 * c];
+			xf[2 * v + 1] = x[l][2 * c + 1];
+		}
+	}
+}
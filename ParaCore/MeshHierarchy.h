@@ -0,0 +1,46 @@
+#pragma once
+#include "MeshTypes.h"
+#include <vector>
+
+/// Coarse-to-fine hierarchy of a triangle mesh for multilevel LSCM.
+/// Each level collapses a maximal matching of short edges, so the
+/// vertex count roughly halves per level in linear time. Pinned
+/// vertices keep their position and stay pinned on every level.
+class MeshHierarchy
+{
+public:
+	enum { MAX_LEVELS = 32 };
+
+	struct Level
+	{
+		std::vector<Mesh::Point> points;
+		std::vector<int> faces;   ///< 3 vertex indices per face
+		std::vector<int> parent;  ///< vertex of the finer level --> vertex of this level
+		int lock[2];
+	};
+
+public:
+	/// coarsen until a level has at most _min_vertices vertices
+	/// or stops shrinking
+	void build(const Mesh::Point* _points, int _n_vertices,
+		const std::vector<int>& _faces, const int _lock[2], int _min_vertices = 1000);
+
+	/// Initial guess for the finest level: LSCM solved on the coarsest
+	/// level, then prolongated and smoothed with _smooth_iter CG
+	/// iterations on every intermediate level. Locked entries of _x are
+	/// kept, the others are overwritten.
+	void solve(std::vector<double>& _x, int _smooth_iter = 30) const;
+
+	/// number of coarse levels, 0 if the mesh is already small
+	int n_levels() const { return (int)levels_.size(); }
+	const Level& level(int _i) const { return levels_[_i]; }
+
+private:
+	static bool pins_valid(const Level& _level);
+	static void coarsen(const Mesh::Point* _points, int _n_vertices,
+		const std::vector<int>& _faces, const int _lock[2], Level& _coarse);
+
+private:
+	std::vector<Level> levels_;
+	int lock_[2];
+};
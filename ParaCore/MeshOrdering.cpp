@@ -0,0 +1,196 @@
+#include "MeshOrdering.h"
+#include <algorithm>
+
+
+void MeshOrdering::build(const std::vector<int>& _faces, int _n_vertices)
+{
+	int nb_faces = (int)_faces.size() / 3;
+
+	// adjacency from the face edges, interior edges appear twice
+	adj_start_.assign(_n_vertices + 1, 0);
+	for (int c = 0; c < 3 * nb_faces; c++)
+		adj_start_[_faces[c] + 1] += 2;
+	for (int v = 0; v < _n_vertices; v++)
+		adj_start_[v + 1] += adj_start_[v];
+	adj_.resize(adj_start_[_n_vertices]);
+	std::vector<int> fill(adj_start_.begin(), adj_start_.end() - 1);
+	for (int f = 0; f < nb_faces; f++)
+	{
+		const int* id = &_faces[3 * f];
+		for (int k = 0; k < 3; k++)
+		{
+			adj_[fill[id[k]]++] = id[(k + 1) % 3];
+			adj_[fill[id[k]]++] = id[(k + 2) % 3];
+		}
+	}
+
+	// sorted and without duplicates, compacted in place
+	int n = 0;
+	for (int v = 0; v < _n_vertices; v++)
+	{
+		int* begin = &adj_[0] + adj_start_[v];
+		int* end = &adj_[0] + adj_start_[v + 1];
+		std::sort(begin, end);
+		end = std::unique(begin, end);
+		adj_start_[v] = n;
+		for (int* a = begin; a != end; ++a)
+			adj_[n++] = *a;
+	}
+	adj_start_[_n_vertices] = n;
+	adj_.resize(n);
+
+	order_.clear();
+	order_.reserve(_n_vertices);
+	rank_.assign(_n_vertices, -1);
+	std::vector<int> level(_n_vertices, -1), queue;
+	queue.reserve(_n_vertices);
+
+	for (int s = 0; s < _n_vertices; s++)
+	{
+		if (rank_[s] >= 0)
+			continue;
+
+		// George-Liu: restart from a vertex of the last level with the
+		// smallest degree while the depth grows
+		int start = s;
+		int depth = bfs(start, level, queue);
+		for (int pass = 0; pass < 4; pass++)
+		{
+			int best = -1;
+			for (size_t i = 0; i < queue.size(); i++)
+			{
+				int v = queue[i];
+				if (level[v] == depth && (best < 0 ||
+					adj_start_[v + 1] - adj_start_[v] < adj_start_[best + 1] - adj_start_[best]))
+					best = v;
+			}
+			int d = bfs(best, level, queue);
+			if (d <= depth)
+				break;
+			start = best;
+			depth = d;
+		}
+		for (size_t i = 0; i < queue.size(); i++)
+			level[queue[i]] = -1;
+
+		// Cuthill-McKee from start, neighbours by increasing degree
+		int first = (int)order_.size();
+		order_.push_back(start);
+		rank_[start] = 0;
+		for (size_t i = first; i < order_.size(); i++)
+		{
+			int v = order_[i];
+			size_t next = order_.size();
+			for (int e = adj_start_[v]; e < adj_start_[v + 1]; e++)
+			{
+				int w = adj_[e];
+				if (rank_[w] < 0)
+				{
+					rank_[w] = 0;
+					order_.push_back(w);
+				}
+			}
+			std::sort(order_.begin() + next, order_.end(), [this](int _a, int _b)
+			{
+				return adj_start_[_a + 1] - adj_start_[_a] < adj_start_[_b + 1] - adj_start_[_b];
+			});
+		}
+	}
+
+	// reversed, which only shrinks the fill of a factorization
+	std::reverse(order_.begin(), order_.end());
+	for (int i = 0; i < _n_vertices; i++)
+		rank_[order_[i]] = i;
+
+	std::vector<int>().swap(adj_start_);
+	std::vector<int>().swap(adj_);
+}
+
+// Breadth first levels from _start, _queue holds the visited vertices.
+// Returns the last level.
+int MeshOrdering::bfs(int _start, std::vector<int>& _level, std::vector<int>& _queue) const
+{
+	for (size_t i = 0; i < _queue.size(); i++)
+		_level[_queue[i]] = -1;
+	_queue.clear();
+
+	_queue.push_back(_start);
+	_level[_start] = 0;
+	int depth = 0;
+	for (size_t i = 0; i < _queue.size(); i++)
+	{
+		int v = _queue[i];
+		depth = _level[v];
+		for (int e = adj_start_[v]; e < adj_start_[v + 1]; e++)
+		{
+			int w = adj_[e];
+			if (_level[w] < 0)
+			{
+				_level[w] = depth + 1;
+				_queue.push_back(w);
+			}
+		}
+	}
+	return depth;
+}
+
+void MeshOrdering::apply_faces(const std::vector<int>& _faces, std::vector<int>& _out) const
+{
+	int nb_faces = (int)_faces.size() / 3;
+	int nb_vertices = n_vertices();
+
+	// counting sort by the smallest new vertex, the corners keep
+	// their orientation
+	std::vector<int> key(nb_faces), start(nb_vertices + 1, 0);
+	for (int f = 0; f < nb_faces; f++)
+	{
+		const int* id = &_faces[3 * f];
+		key[f] = std::min(rank_[id[0]], std::min(rank_[id[1]], rank_[id[2]]));
+		start[key[f] + 1]++;
+	}
+	for (int v = 0; v < nb_vertices; v++)
+		start[v + 1] += start[v];
+
+	_out.resize(_faces.size());
+	for (int f = 0; f < nb_faces; f++)
+	{
+		int g = start[key[f]]++;
+		for (int k = 0; k < 3; k++)
+			_out[3 * g + k] = rank_[_faces[3 * f + k]];
+	}
+}
+
+void MeshOrdering::apply_points(const Mesh::Point* _points, std::vector<Mesh::Point>& _out) const
+{
+	int nb_vertices = n_vertices();
+	_out.resize(nb_vertices);
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < nb_vertices; i++)
+		_out[i] = _points[order_[i]];
+}
+
+void MeshOrdering::to_new(std::vector<double>& _x) const
+{
+	std::vector<double> x(_x.size());
+	int nb_vertices = n_vertices();
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < nb_vertices; i++)
+	{
+		x[2 * i] = _x[2 * order_[i]];
+		x[2 * i + 1] = _x[2 * order_[i] + 1];
+	}
+	_x.swap(x);
+}
+
+void MeshOrdering::to_old(std::vector<double>& _x) const
+{
+	std::vector<double> x(_x.size());
+	int nb_vertices = n_vertices();
+#pragma omp parallel for schedule(static)
+	for (int i = 0; i < nb_vertices; i++)
+	{
+		x[2 * order_[i]] = _x[2 * i];
+		x[2 * order_[i] + 1] = _x[2 * i + 1];
+	}
+	_x.swap(x);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "MeshTypes.h"
+#include <vector>
+
+/// Vertex and face order with good locality for the LSCM system.
+/// Reverse Cuthill-McKee numbers the vertices breadth first, so the
+/// neighbours of a vertex get close indices: the unknowns a row reads
+/// share cache lines and the matrix has a small bandwidth. Faces are
+/// then sorted by their smallest new vertex.
+class MeshOrdering
+{
+public:
+	/// order of the vertices of a flat face list (3 vertex indices per
+	/// face), every connected component starts at a pseudo-peripheral
+	/// vertex
+	void build(const std::vector<int>& _faces, int _n_vertices);
+
+	int n_vertices() const { return (int)order_.size(); }
+	/// new index --> old index
+	const std::vector<int>& order() const { return order_; }
+	/// old index --> new index
+	const std::vector<int>& rank() const { return rank_; }
+
+	/// faces with the new vertex indices, in the new face order
+	void apply_faces(const std::vector<int>& _faces, std::vector<int>& _out) const;
+	/// points in the new order
+	void apply_points(const Mesh::Point* _points, std::vector<Mesh::Point>& _out) const;
+	/// (u,v) per vertex from the old to the new order, and back
+	void to_new(std::vector<double>& _x) const;
+	void to_old(std::vector<double>& _x) const;
+
+private:
+	int bfs(int _start, std::vector<int>& _level, std::vector<int>& _queue) const;
+
+private:
+	std::vector<int> order_;
+	std::vector<int> rank_;
+
+	// vertex adjacency, neighbours of v at
+	// adj_[adj_start_[v] .. adj_start_[v+1])
+	std::vector<int> adj_start_;
+	std::vector<int> adj_;
+};
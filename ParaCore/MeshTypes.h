@@ -0,0 +1,7 @@
+#pragma once
+#include <OpenMesh/Core/Geometry/VectorT.hh>
+#include <OpenMesh/Core/Mesh/TriMesh_ArrayKernelT.hh>
+using namespace OpenMesh;
+
+/// Triangle mesh shared by the viewer and the GL-free parameterization core
+typedef OpenMesh::TriMesh_ArrayKernelT<>  Mesh;
@@ -0,0 +1,363 @@
+#include <OpenMesh/Core/IO/MeshIO.hh>
+#include "ObjReader.h"
+#include "MappedFile.h"
+#include <omp.h>
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <iostream>
+
+// chunks below this size are not worth a thread
+static const size_t MIN_CHUNK = 1 << 20;
+
+
+static inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char* skip_blank(const char* p, const char* end)
+{
+	while (p < end && is_blank(*p))
+		++p;
+	return p;
+}
+
+static inline const char* next_line(const char* p, const char* end)
+{
+	while (p < end && *p != '\n')
+		++p;
+	return p < end ? p + 1 : end;
+}
+
+static inline const char* skip_token(const char* p, const char* end)
+{
+	while (p < end && !is_blank(*p) && *p != '\n')
+		++p;
+	return p;
+}
+
+static double power_of_ten(int e)
+{
+	static const double table[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	return e <= 22 ? table[e] : std::pow(10.0, e);
+}
+
+// Locale-free decimal parser, up to 19 significant digits and an
+// exponent. Returns NULL if there is no number at p.
+static const char* parse_float(const char* p, const char* end, float& _value)
+{
+	bool neg = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		neg = *p++ == '-';
+
+	unsigned long long m = 0;
+	int digits = 0, exp10 = 0;
+	bool any = false;
+	for (; p < end && is_digit(*p); ++p)
+	{
+		any = true;
+		if (digits < 19)
+		{
+			m = 10 * m + (*p - '0');
+			if (m)
+				digits++;
+		}
+		else
+			exp10++;
+	}
+	if (p < end && *p == '.')
+	{
+		for (++p; p < end && is_digit(*p); ++p)
+		{
+			any = true;
+			if (digits < 19)
+			{
+				m = 10 * m + (*p - '0');
+				if (m)
+					digits++;
+				exp10--;
+			}
+		}
+	}
+	if (!any)
+		return NULL;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* q = p + 1;
+		bool eneg = false;
+		if (q < end && (*q == '-' || *q == '+'))
+			eneg = *q++ == '-';
+		if (q < end && is_digit(*q))
+		{
+			int e = 0;
+			for (; q < end && is_digit(*q); ++q)
+			{
+				if (e < 10000)
+					e = 10 * e + (*q - '0');
+			}
+			exp10 += eneg ? -e : e;
+			p = q;
+		}
+	}
+
+	double v = (double)m;
+	v = exp10 < 0 ? v / power_of_ten(-exp10) : v * power_of_ten(exp10);
+	_value = (float)(neg ? -v : v);
+	return p;
+}
+
+static const char* parse_int(const char* p, const char* end, int& _value)
+{
+	bool neg = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		neg = *p++ == '-';
+	if (p >= end || !is_digit(*p))
+		return NULL;
+
+	long long v = 0;
+	for (; p < end && is_digit(*p); ++p)
+	{
+		if (v <= INT_MAX)
+			v = 10 * v + (*p - '0');
+	}
+	if (v > INT_MAX)
+		return NULL;
+	_value = (int)(neg ? -v : v);
+	return p;
+}
+
+// "v x y z" and "f a b c ...", the other lines are skipped, as is a
+// trailing "# comment"
+static inline bool is_key(const char* p, const char* end, char _key)
+{
+	return p + 1 < end && p[0] == _key && is_blank(p[1]);
+}
+
+
+ObjReader::ObjReader() :
+bb_min_(0.0f, 0.0f, 0.0f), bb_max_(0.0f, 0.0f, 0.0f)
+{
+}
+
+void ObjReader::count_chunk(Chunk& _chunk)
+{
+	int nv = 0, nf = 0;
+	const char* end = _chunk.end;
+	for (const char* p = _chunk.begin; p < end; p = next_line(p, end))
+	{
+		p = skip_blank(p, end);
+		if (is_key(p, end, 'v'))
+			nv++;
+		else if (is_key(p, end, 'f'))
+		{
+			int refs = 0;
+			for (p = skip_blank(p + 1, end); p < end && *p != '\n' && *p != '#'; p = skip_blank(p, end))
+			{
+				p = skip_token(p, end);
+				refs++;
+			}
+			if (refs >= 3)
+				nf += refs - 2;
+		}
+	}
+	_chunk.n_vertices = nv;
+	_chunk.n_faces = nf;
+}
+
+void ObjReader::parse_chunk(Chunk& _chunk, Mesh::Point* _points, int* _faces)
+{
+	Mesh::Point* point = _points + _chunk.vertex_offset;
+	int* face = _faces + 3 * _chunk.face_offset;
+	int nv = _chunk.vertex_offset;
+
+	_chunk.ok = true;
+	_chunk.bb_min = Mesh::Point(FLT_MAX, FLT_MAX, FLT_MAX);
+	_chunk.bb_max = Mesh::Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	const char* end = _chunk.end;
+	for (const char* p = _chunk.begin; p < end; p = next_line(p, end))
+	{
+		p = skip_blank(p, end);
+		if (is_key(p, end, 'v'))
+		{
+			Mesh::Point v;
+			p = skip_blank(p + 1, end);
+			for (int k = 0; k < 3 && p; k++)
+			{
+				p = parse_float(p, end, v[k]);
+				if (p)
+					p = skip_blank(p, end);
+			}
+			if (!p)
+			{
+				_chunk.ok = false;
+				return;
+			}
+			*point++ = v;
+			_chunk.bb_min.minimize(v);
+			_chunk.bb_max.maximize(v);
+			nv++;
+		}
+		else if (is_key(p, end, 'f'))
+		{
+			// fan triangulation, negative indices count back from
+			// the last vertex read so far
+			int first = -1, prev = -1, refs = 0;
+			for (p = skip_blank(p + 1, end); p < end && *p != '\n' && *p != '#'; p = skip_blank(p, end))
+			{
+				int idx;
+				const char* q = parse_int(p, end, idx);
+				if (!q || idx == 0)
+				{
+					_chunk.ok = false;
+					return;
+				}
+				idx = idx > 0 ? idx - 1 : nv + idx;
+				p = skip_token(q, end);
+
+				if (refs == 0)
+					first = idx;
+				else if (refs >= 2)
+				{
+					face[0] = first;
+					face[1] = prev;
+					face[2] = idx;
+					face += 3;
+				}
+				prev = idx;
+				refs++;
+			}
+		}
+	}
+}
+
+bool ObjReader::read(const char* _filename)
+{
+	points_.clear();
+	faces_.clear();
+
+	MappedFile file;
+	if (!file.open(_filename))
+	{
+		std::cerr << _filename << ": cannot open file\n";
+		return false;
+	}
+	const char* data = file.data();
+	size_t size = file.size();
+
+	// chunk borders move forward to the next line
+	size_t max_chunks = std::max((size_t)1, size / MIN_CHUNK);
+	int nb_chunks = (int)std::min((size_t)(4 * omp_get_max_threads()), max_chunks);
+	std::vector<Chunk> chunks(nb_chunks);
+	const char* begin = data;
+	for (int c = 0; c < nb_chunks; c++)
+	{
+		const char* end = c + 1 == nb_chunks ? data + size :
+			next_line(data + size / nb_chunks * (c + 1), data + size);
+		chunks[c].begin = begin;
+		chunks[c].end = std::max(begin, end);
+		begin = chunks[c].end;
+	}
+
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int c = 0; c < nb_chunks; c++)
+		count_chunk(chunks[c]);
+
+	long long nv = 0, nf = 0;
+	for (int c = 0; c < nb_chunks; c++)
+	{
+		chunks[c].vertex_offset = (int)nv;
+		chunks[c].face_offset = (int)nf;
+		nv += chunks[c].n_vertices;
+		nf += chunks[c].n_faces;
+		if (3 * nf > INT_MAX)
+		{
+			std::cerr << _filename << ": too many faces\n";
+			return false;
+		}
+	}
+
+	points_.resize((size_t)nv);
+	faces_.resize((size_t)(3 * nf));
+	Mesh::Point* points = nv ? &points_[0] : NULL;
+	int* faces = nf ? &faces_[0] : NULL;
+
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int c = 0; c < nb_chunks; c++)
+		parse_chunk(chunks[c], points, faces);
+
+	bool ok = true;
+	bb_min_ = Mesh::Point(FLT_MAX, FLT_MAX, FLT_MAX);
+	bb_max_ = Mesh::Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (int c = 0; c < nb_chunks; c++)
+	{
+		ok = ok && chunks[c].ok;
+		bb_min_.minimize(chunks[c].bb_min);
+		bb_max_.maximize(chunks[c].bb_max);
+	}
+
+	int bad = 0;
+	int n = (int)faces_.size();
+#pragma omp parallel for reduction(+:bad)
+	for (int i = 0; i < n; i++)
+	{
+		if (faces_[i] < 0 || faces_[i] >= nv)
+			bad++;
+	}
+
+	if (!ok || bad || nv == 0)
+	{
+		std::cerr << _filename << ": not a valid OBJ file\n";
+		points_.clear();
+		faces_.clear();
+		return false;
+	}
+	return true;
+}
+
+int ObjReader::build_mesh(Mesh& _mesh) const
+{
+	int nv = n_vertices();
+	int nf = n_faces();
+
+	_mesh.clear();
+	_mesh.reserve(nv, 3 * nf / 2 + nv, nf);
+
+	std::vector<Mesh::VertexHandle> vh(nv);
+	for (int i = 0; i < nv; i++)
+		vh[i] = _mesh.add_vertex(points_[i]);
+
+	int added = 0;
+	for (int f = 0; f < nf; f++)
+	{
+		const int* id = &faces_[3 * f];
+		if (id[0] == id[1] || id[1] == id[2] || id[2] == id[0])
+			continue;
+		if (_mesh.add_face(vh[id[0]], vh[id[1]], vh[id[2]]).is_valid())
+			added++;
+	}
+	return added;
+}
+
+bool ObjReader::is_obj(const std::string& _filename)
+{
+	std::string ext = _filename.size() > 4 ? _filename.substr(_filename.size() - 4) : "";
+	std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+	return ext == ".obj";
+}
+
+bool ObjReader::read_mesh(Mesh& _mesh, const std::string& _filename)
+{
+	if (!is_obj(_filename))
+		return OpenMesh::IO::read_mesh(_mesh, _filename);
+
+	ObjReader reader;
+	if (!reader.read(_filename.c_str()))
+		return false;
+	reader.build_mesh(_mesh);
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "MeshTypes.h"
+#include <string>
+#include <vector>
+
+/// Fast OBJ reader. The file is memory mapped and split into chunks
+/// at line breaks, which are parsed in parallel with a locale-free
+/// number parser: one pass counts the vertices and triangles of every
+/// chunk, the second one writes them at their final offsets. Only
+/// "v" and "f" lines are read, polygons are split into triangle fans.
+/// The halfedge mesh is not built until build_mesh() is called.
+class ObjReader
+{
+public:
+	ObjReader();
+
+	bool read(const char* _filename);
+
+	const std::vector<Mesh::Point>& points() const { return points_; }
+	/// 3 vertex indices per triangle
+	const std::vector<int>& faces() const { return faces_; }
+	int n_vertices() const { return (int)points_.size(); }
+	int n_faces() const { return (int)faces_.size() / 3; }
+
+	/// bounding box of the vertices, computed while parsing
+	const Mesh::Point& bb_min() const { return bb_min_; }
+	const Mesh::Point& bb_max() const { return bb_max_; }
+
+	/// Halfedge mesh of the triangles, in file order. Faces OpenMesh
+	/// rejects (complex edges) are skipped, returns the faces added.
+	int build_mesh(Mesh& _mesh) const;
+
+	/// the file name ends with .obj, in any case
+	static bool is_obj(const std::string& _filename);
+	/// fast path for .obj files, OpenMesh::IO::read_mesh otherwise
+	static bool read_mesh(Mesh& _mesh, const std::string& _filename);
+
+private:
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+		int n_vertices;
+		int n_faces;
+		int vertex_offset;
+		int face_offset;
+		bool ok;
+		Mesh::Point bb_min, bb_max;
+	};
+
+	static void count_chunk(Chunk& _chunk);
+	static void parse_chunk(Chunk& _chunk, Mesh::Point* _points, int* _faces);
+
+private:
+	std::vector<Mesh::Point> points_;
+	std::vector<int> faces_;
+	Mesh::Point bb_min_, bb_max_;
+};
@@ -0,0 +1,356 @@
+#include <OpenMesh/Core/IO/MeshIO.hh>
+#include "ObjWriter.h"
+#include "BinaryMesh.h"
+#include "ObjReader.h"
+#include <omp.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// lines per chunk, a batch has a few chunks per thread
+static const int CHUNK_LINES = 1 << 14;
+// "-0.0000123456789" is the longest float, 10 digits the longest index
+static const int MAX_FLOAT = 16;
+static const int MAX_INT = 10;
+// "vn" and three floats, "f" and three "v/vt/vn"
+static const int MAX_VERTEX_LINE = 3 + 3 * (1 + MAX_FLOAT);
+static const int MAX_FACE_LINE = 2 + 3 * (3 + 3 * MAX_INT);
+
+
+static char* format_uint(unsigned int _value, char* _out)
+{
+	char digits[MAX_INT + 1];
+	int n = 0;
+	do
+	{
+		digits[n++] = (char)('0' + _value % 10);
+		_value /= 10;
+	} while (_value);
+	while (n)
+		*_out++ = digits[--n];
+	return _out;
+}
+
+static double power_of_ten(int e)
+{
+	static const double table[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	return e <= 22 ? table[e] : std::pow(10.0, e);
+}
+
+// value of the decimal _m * 10^_exp10, computed like ObjReader does
+static float decimal_value(unsigned int _m, int _exp10)
+{
+	double v = (double)_m;
+	return (float)(_exp10 < 0 ? v / power_of_ten(-_exp10) : v * power_of_ten(_exp10));
+}
+
+// Shortest round trip: the fewest significant digits (at most 9, which
+// are always enough for a float) that read back to the same float.
+// Fixed notation for exponents from -5 to 8, scientific otherwise.
+static char* format_float(float _value, char* _out)
+{
+	if (_value != _value)
+	{
+		memcpy(_out, "nan", 3);
+		return _out + 3;
+	}
+	if (_value < 0.0f)
+	{
+		*_out++ = '-';
+		_value = -_value;
+	}
+	if (_value == 0.0f)
+	{
+		*_out++ = '0';
+		return _out;
+	}
+	if (_value > 3.4028235e38f)
+	{
+		memcpy(_out, "inf", 3);
+		return _out + 3;
+	}
+
+	// log10 can be off by one next to powers of ten
+	int e = (int)std::floor(std::log10((double)_value));
+	double p = e < 0 ? 1.0 / power_of_ten(-e) : power_of_ten(e);
+	if (_value < p)
+		e--;
+	else if (_value >= 10.0 * p)
+		e++;
+
+	unsigned int m = 0;
+	int exp10 = 0;
+	for (int digits = 1; digits <= 9; digits++)
+	{
+		exp10 = e - digits + 1;
+		double scaled = exp10 < 0 ? _value * power_of_ten(-exp10) : _value / power_of_ten(exp10);
+		m = (unsigned int)(scaled + 0.5);
+		if (m >= (unsigned int)power_of_ten(digits))
+		{
+			// rounded up to the next power of ten
+			m /= 10;
+			exp10++;
+		}
+		if (digits == 9 || decimal_value(m, exp10) == _value)
+			break;
+	}
+
+	// drop trailing zeros of the mantissa
+	while (m >= 10 && m % 10 == 0)
+	{
+		m /= 10;
+		exp10++;
+	}
+	int digits = 1;
+	while (digits < 9 && m >= (unsigned int)power_of_ten(digits))
+		digits++;
+	e = exp10 + digits - 1;
+
+	char d[9];
+	for (int i = digits - 1; i >= 0; i--, m /= 10)
+		d[i] = (char)('0' + m % 10);
+
+	if (e >= -5 && e <= 8)
+	{
+		if (e < 0)
+		{
+			*_out++ = '0';
+			*_out++ = '.';
+			for (int i = -1; i > e; i--)
+				*_out++ = '0';
+			for (int i = 0; i < digits; i++)
+				*_out++ = d[i];
+		}
+		else
+		{
+			for (int i = 0; i <= e; i++)
+				*_out++ = i < digits ? d[i] : '0';
+			if (digits > e + 1)
+			{
+				*_out++ = '.';
+				for (int i = e + 1; i < digits; i++)
+					*_out++ = d[i];
+			}
+		}
+	}
+	else
+	{
+		*_out++ = d[0];
+		if (digits > 1)
+		{
+			*_out++ = '.';
+			for (int i = 1; i < digits; i++)
+				*_out++ = d[i];
+		}
+		*_out++ = 'e';
+		if (e < 0)
+		{
+			*_out++ = '-';
+			e = -e;
+		}
+		_out = format_uint((unsigned int)e, _out);
+	}
+	return _out;
+}
+
+static char* format_floats(const char* _key, const float* _v, int _n, char* _out)
+{
+	while (*_key)
+		*_out++ = *_key++;
+	for (int k = 0; k < _n; k++)
+	{
+		*_out++ = ' ';
+		_out = format_float(_v[k], _out);
+	}
+	*_out++ = '\n';
+	return _out;
+}
+
+
+ObjWriter::ObjWriter(const Mesh& _mesh) :
+mesh_(_mesh), texcoords_(NO_TEXCOORDS), normals_(false)
+{
+}
+
+ObjWriter::TexCoords ObjWriter::texcoords(OpenMesh::IO::Options _opt) const
+{
+	if (_opt.check(OpenMesh::IO::Options::FaceTexCoord) && mesh_.has_halfedge_texcoords2D())
+		return CORNER_TEXCOORDS;
+	if (_opt.check(OpenMesh::IO::Options::VertexTexCoord) && mesh_.has_vertex_texcoords2D())
+		return VERTEX_TEXCOORDS;
+	return NO_TEXCOORDS;
+}
+
+char* ObjWriter::vertex_line(int _v, char* _out) const
+{
+	return format_floats("v", mesh_.point(Mesh::VertexHandle(_v)).data(), 3, _out);
+}
+
+char* ObjWriter::normal_line(int _v, char* _out) const
+{
+	return format_floats("vn", mesh_.normal(Mesh::VertexHandle(_v)).data(), 3, _out);
+}
+
+char* ObjWriter::texcoord_line(int _v, char* _out) const
+{
+	return format_floats("vt", mesh_.texcoord2D(Mesh::VertexHandle(_v)).data(), 2, _out);
+}
+
+// corner _c is corner _c % 3 of face _c / 3
+char* ObjWriter::corner_line(int _c, char* _out) const
+{
+	auto fh_it = mesh_.cfh_iter(Mesh::FaceHandle(_c / 3));
+	for (int k = _c % 3; k > 0; k--)
+		++fh_it;
+	return format_floats("vt", mesh_.texcoord2D(*fh_it).data(), 2, _out);
+}
+
+char* ObjWriter::face_line(int _f, char* _out) const
+{
+	*_out++ = 'f';
+	int k = 0;
+	for (auto fh_it = mesh_.cfh_iter(Mesh::FaceHandle(_f)); fh_it.is_valid(); ++fh_it, ++k)
+	{
+		unsigned int v = mesh_.to_vertex_handle(*fh_it).idx() + 1;
+		*_out++ = ' ';
+		_out = format_uint(v, _out);
+		if (texcoords_ != NO_TEXCOORDS || normals_)
+		{
+			*_out++ = '/';
+			if (texcoords_ == VERTEX_TEXCOORDS)
+				_out = format_uint(v, _out);
+			else if (texcoords_ == CORNER_TEXCOORDS)
+				_out = format_uint(3 * _f + k + 1, _out);
+		}
+		if (normals_)
+		{
+			*_out++ = '/';
+			_out = format_uint(v, _out);
+		}
+	}
+	*_out++ = '\n';
+	return _out;
+}
+
+// Formats a batch of chunks in parallel, then writes them in order
+bool ObjWriter::write_lines(FILE* _file, int _n, int _max_line, Format _format) const
+{
+	int n_chunks = 4 * omp_get_max_threads();
+	std::vector<std::vector<char> > buffers(n_chunks);
+	std::vector<size_t> sizes(n_chunks);
+
+	for (int batch = 0; batch < _n; batch += n_chunks * CHUNK_LINES)
+	{
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int c = 0; c < n_chunks; c++)
+		{
+			int begin = std::min(_n, batch + c * CHUNK_LINES);
+			int end = std::min(_n, begin + CHUNK_LINES);
+			std::vector<char>& buffer = buffers[c];
+			buffer.resize((size_t)(end - begin) * _max_line + 1);
+			char* out = &buffer[0];
+			for (int i = begin; i < end; i++)
+				out = (this->*_format)(i, out);
+			sizes[c] = out - &buffer[0];
+		}
+
+		for (int c = 0; c < n_chunks; c++)
+		{
+			if (sizes[c] && fwrite(&buffers[c][0], 1, sizes[c], _file) != sizes[c])
+				return false;
+		}
+	}
+	return true;
+}
+
+bool ObjWriter::write(const char* _filename, OpenMesh::IO::Options _opt)
+{
+	FILE* file = fopen(_filename, "wb");
+	if (!file)
+	{
+		std::cerr << _filename << ": cannot write file\n";
+		return false;
+	}
+
+	texcoords_ = texcoords(_opt);
+	normals_ = _opt.check(OpenMesh::IO::Options::VertexNormal) && mesh_.has_vertex_normals();
+
+	int nv = (int)mesh_.n_vertices();
+	int nf = (int)mesh_.n_faces();
+	fprintf(file, "# %d vertices, %d faces\n", nv, nf);
+
+	bool ok = write_lines(file, nv, MAX_VERTEX_LINE, &ObjWriter::vertex_line);
+	if (ok && texcoords_ == VERTEX_TEXCOORDS)
+		ok = write_lines(file, nv, MAX_VERTEX_LINE, &ObjWriter::texcoord_line);
+	if (ok && texcoords_ == CORNER_TEXCOORDS)
+		ok = write_lines(file, 3 * nf, MAX_VERTEX_LINE, &ObjWriter::corner_line);
+	if (ok && normals_)
+		ok = write_lines(file, nv, MAX_VERTEX_LINE, &ObjWriter::normal_line);
+	if (ok)
+		ok = write_lines(file, nf, MAX_FACE_LINE, &ObjWriter::face_line);
+
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << _filename << ": cannot write file\n";
+		return false;
+	}
+	return true;
+}
+
+bool ObjWriter::write_uv(const char* _filename, OpenMesh::IO::Options _opt)
+{
+	texcoords_ = texcoords(_opt);
+	if (texcoords_ == NO_TEXCOORDS)
+	{
+		std::cerr << _filename << ": no texcoords to write\n";
+		return false;
+	}
+
+	FILE* file = fopen(_filename, "wb");
+	if (!file)
+	{
+		std::cerr << _filename << ": cannot write file\n";
+		return false;
+	}
+
+	bool ok;
+	if (texcoords_ == VERTEX_TEXCOORDS)
+	{
+		int nv = (int)mesh_.n_vertices();
+		fprintf(file, "# uv vertex %d\n", nv);
+		ok = write_lines(file, nv, MAX_VERTEX_LINE, &ObjWriter::texcoord_line);
+	}
+	else
+	{
+		int nc = 3 * (int)mesh_.n_faces();
+		fprintf(file, "# uv corner %d\n", nc);
+		ok = write_lines(file, nc, MAX_VERTEX_LINE, &ObjWriter::corner_line);
+	}
+
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << _filename << ": cannot write file\n";
+		return false;
+	}
+	return true;
+}
+
+char* ObjWriter::format_texcoord(const float* _uv, char* _out)
+{
+	return format_floats("vt", _uv, 2, _out);
+}
+
+bool ObjWriter::write_mesh(const Mesh& _mesh, const std::string& _filename,
+	OpenMesh::IO::Options _opt)
+{
+	if (BinaryMesh::is_binary(_filename))
+		return BinaryMesh::write(_mesh, _filename.c_str(), _opt);
+	if (ObjReader::is_obj(_filename))
+		return ObjWriter(_mesh).write(_filename.c_str(), _opt);
+	return OpenMesh::IO::write_mesh(_mesh, _filename, _opt);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "MeshTypes.h"
+#include <OpenMesh/Core/IO/Options.hh>
+#include <cstdio>
+#include <string>
+
+/// Fast OBJ writer. Lines are formatted in parallel, in chunks that
+/// are written in file order with one fwrite each. Floats get the
+/// fewest digits that read back to the same value.
+///
+/// VertexTexCoord in the options writes one "vt" per vertex,
+/// FaceTexCoord one per face corner (in face order, so seams need no
+/// lookup) and VertexNormal one "vn" per vertex.
+class ObjWriter
+{
+public:
+	ObjWriter(const Mesh& _mesh);
+
+	/// vertices, the texcoords and normals in _opt, and faces
+	bool write(const char* _filename, OpenMesh::IO::Options _opt);
+
+	/// UV sidecar: only the "vt" lines, after a "# uv vertex n" or
+	/// "# uv corner n" line, for a geometry file that did not change
+	bool write_uv(const char* _filename, OpenMesh::IO::Options _opt);
+
+	/// .obj through ObjWriter, .pmesh through BinaryMesh and the other
+	/// formats through OpenMesh::IO::write_mesh
+	static bool write_mesh(const Mesh& _mesh, const std::string& _filename,
+		OpenMesh::IO::Options _opt = OpenMesh::IO::Options::Default);
+
+	/// longest "vt" line
+	enum { MAX_TEXCOORD_LINE = 3 + 2 * 17 };
+	/// one "vt u v" line of a UV sidecar, for texcoords that are not in
+	/// a Mesh (see StreamingSolver)
+	static char* format_texcoord(const float* _uv, char* _out);
+
+private:
+	enum TexCoords { NO_TEXCOORDS, VERTEX_TEXCOORDS, CORNER_TEXCOORDS };
+
+	typedef char* (ObjWriter::*Format)(int _i, char* _out) const;
+
+	TexCoords texcoords(OpenMesh::IO::Options _opt) const;
+	bool write_lines(FILE* _file, int _n, int _max_line, Format _format) const;
+
+	char* vertex_line(int _v, char* _out) const;
+	char* normal_line(int _v, char* _out) const;
+	char* texcoord_line(int _v, char* _out) const;
+	char* corner_line(int _c, char* _out) const;
+	char* face_line(int _f, char* _out) const;
+
+private:
+	const Mesh& mesh_;
+	TexCoords texcoords_;
+	bool normals_;
+};
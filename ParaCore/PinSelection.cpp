@@ -0,0 +1,100 @@
+#include "PinSelection.h"
+#include <algorithm>
+
+// farthest candidate from _from
+static int farthest(const Mesh::Point* _points, const std::vector<int>& _candidates, int _from,
+	float& _dist2)
+{
+	int best = _candidates[0];
+	_dist2 = -1.0f;
+	for (size_t i = 0; i < _candidates.size(); i++)
+	{
+		float d2 = (_points[_candidates[i]] - _points[_from]).sqrnorm();
+		if (d2 > _dist2)
+		{
+			_dist2 = d2;
+			best = _candidates[i];
+		}
+	}
+	return best;
+}
+
+bool select_pins(const Mesh::Point* _points, int _n_vertices,
+	const std::vector<int>& _faces, int _pins[2])
+{
+	int nb_corners = (int)_faces.size();
+
+	// halfedges a -> b by their source vertex
+	std::vector<int> start(_n_vertices + 1, 0), target(nb_corners);
+	for (int c = 0; c < nb_corners; c++)
+		start[_faces[c] + 1]++;
+	for (int v = 0; v < _n_vertices; v++)
+		start[v + 1] += start[v];
+	std::vector<int> fill(start.begin(), start.end() - 1);
+	for (int c = 0; c < nb_corners; c++)
+	{
+		int next = c % 3 == 2 ? c - 2 : c + 1;
+		target[fill[_faces[c]]++] = _faces[next];
+	}
+
+	// a halfedge without its opposite b -> a is on the boundary
+	std::vector<unsigned char> boundary(_n_vertices, 0);
+	for (int a = 0; a < _n_vertices; a++)
+	{
+		for (int e = start[a]; e < start[a + 1]; e++)
+		{
+			int b = target[e];
+			const int* begin = &target[0] + start[b];
+			const int* end = &target[0] + start[b + 1];
+			if (std::find(begin, end, a) == end)
+				boundary[a] = boundary[b] = 1;
+		}
+	}
+
+	std::vector<int> candidates;
+	for (int v = 0; v < _n_vertices; v++)
+	{
+		if (boundary[v])
+			candidates.push_back(v);
+	}
+	if (candidates.size() < 2)
+	{
+		candidates.clear();
+		for (int v = 0; v < _n_vertices; v++)
+		{
+			if (start[v + 1] > start[v])
+				candidates.push_back(v);
+		}
+	}
+	if (candidates.empty())
+		return false;
+
+	// each sweep from the far end of the last one, while it grows
+	float d2 = 0.0f, best2 = 0.0f;
+	int a = farthest(_points, candidates, candidates[0], d2);
+	int b = farthest(_points, candidates, a, best2);
+	for (int sweep = 0; sweep < 2; sweep++)
+	{
+		int c = farthest(_points, candidates, b, d2);
+		if (d2 <= best2)
+			break;
+		a = b;
+		b = c;
+		best2 = d2;
+	}
+	if (a == b)
+		return false;
+
+	_pins[0] = a;
+	_pins[1] = b;
+	return true;
+}
+
+bool pins_separated(const Mesh::Point* _points, const std::vector<double>& _x,
+	const int _pins[2])
+{
+	double du = _x[2 * _pins[0]] - _x[2 * _pins[1]];
+	double dv = _x[2 * _pins[0] + 1] - _x[2 * _pins[1] + 1];
+	double d2 = (_points[_pins[0]] - _points[_pins[1]]).sqrnorm();
+	return du * du + dv * dv > 0.01 * d2 && d2 > 0.0;
+}
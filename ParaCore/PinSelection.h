@@ -0,0 +1,19 @@
+#pragma once
+#include "MeshTypes.h"
+#include <vector>
+
+/// Two well separated pins for LSCM on a flat face list (3 vertex
+/// indices per face): the ends of an approximate diameter of the
+/// boundary, from farthest point sweeps over the boundary vertices.
+/// Pins on the boundary and far apart fix the similarity of the map
+/// without distorting it, which keeps the system well conditioned.
+/// Closed meshes sweep all vertices of the faces. Linear time.
+/// False if the faces have fewer than two distinct vertices.
+bool select_pins(const Mesh::Point* _points, int _n_vertices,
+	const std::vector<int>& _faces, int _pins[2]);
+
+/// The pins are fixed where the initial guess _x puts them, which
+/// must not squeeze them together: true if they are at least a
+/// tenth of their straight-line distance in 3D apart in _x.
+bool pins_separated(const Mesh::Point* _points, const std::vector<double>& _x,
+	const int _pins[2]);
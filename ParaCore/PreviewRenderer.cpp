@@ -0,0 +1,319 @@
+#include "PreviewRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+static const unsigned char BACKGROUND = 64;
+
+
+// The viewer uploads 64x64 texels from its 128 wide check image, so
+// its checker cells are 2 texels wide and 4 high, repeated
+static unsigned char checker(float _u, float _v)
+{
+	int s = (int)std::floor(_u * 64.0f);
+	int t = (int)std::floor(_v * 64.0f);
+	bool a = (t & 4) == 0;
+	bool b = (s & 2) == 0;
+	return a != b ? 255 : 40;
+}
+
+PreviewRenderer::PreviewRenderer(const Mesh& _mesh) :
+mesh_(_mesh), corners_(false)
+{
+}
+
+// positions and texcoords of the corners, 3 per face
+bool PreviewRenderer::gather(std::vector<Vec3f>& _p, std::vector<Vec2f>& _t) const
+{
+	if (corners_ ? !mesh_.has_halfedge_texcoords2D() : !mesh_.has_vertex_texcoords2D())
+		return false;
+
+	int nb_faces = (int)mesh_.n_faces();
+	_p.resize(3 * nb_faces);
+	_t.resize(3 * nb_faces);
+	for (int f = 0; f < nb_faces; f++)
+	{
+		int k = 0;
+		for (auto fh_it = mesh_.cfh_iter(Mesh::FaceHandle(f)); fh_it.is_valid() && k < 3; ++fh_it, ++k)
+		{
+			Mesh::VertexHandle vh = mesh_.to_vertex_handle(*fh_it);
+			_p[3 * f + k] = mesh_.point(vh);
+			_t[3 * f + k] = corners_ ? mesh_.texcoord2D(*fh_it) : mesh_.texcoord2D(vh);
+		}
+	}
+	return true;
+}
+
+// Fills the pixels whose centers are inside the triangle (x, y in
+// pixels), _shade gets the barycentric weights of the pixel
+template <class Shade>
+static void fill_triangle(const float* _x, const float* _y, int _size, Shade _shade)
+{
+	float area = (_x[1] - _x[0]) * (_y[2] - _y[0]) - (_x[2] - _x[0]) * (_y[1] - _y[0]);
+	if (area == 0.0f)
+		return;
+	int x0 = std::max(0, (int)std::floor(std::min(_x[0], std::min(_x[1], _x[2]))));
+	int x1 = std::min(_size - 1, (int)std::ceil(std::max(_x[0], std::max(_x[1], _x[2]))));
+	int y0 = std::max(0, (int)std::floor(std::min(_y[0], std::min(_y[1], _y[2]))));
+	int y1 = std::min(_size - 1, (int)std::ceil(std::max(_y[0], std::max(_y[1], _y[2]))));
+
+	float inv = 1.0f / area;
+	for (int y = y0; y <= y1; y++)
+	{
+		float py = y + 0.5f;
+		for (int x = x0; x <= x1; x++)
+		{
+			float px = x + 0.5f;
+			float w0 = ((_x[1] - px) * (_y[2] - py) - (_x[2] - px) * (_y[1] - py)) * inv;
+			float w1 = ((_x[2] - px) * (_y[0] - py) - (_x[0] - px) * (_y[2] - py)) * inv;
+			float w2 = 1.0f - w0 - w1;
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+			_shade(x, y, w0, w1, w2);
+		}
+	}
+}
+
+static void darken_line(float _x0, float _y0, float _x1, float _y1, int _size,
+	std::vector<unsigned char>& _rgb)
+{
+	int steps = (int)std::ceil(std::max(std::fabs(_x1 - _x0), std::fabs(_y1 - _y0))) + 1;
+	for (int i = 0; i <= steps; i++)
+	{
+		float a = (float)i / steps;
+		int x = (int)(_x0 + a * (_x1 - _x0));
+		int y = (int)(_y0 + a * (_y1 - _y0));
+		if (x < 0 || y < 0 || x >= _size || y >= _size)
+			continue;
+		unsigned char* c = &_rgb[3 * (y * _size + x)];
+		for (int k = 0; k < 3; k++)
+			c[k] = (unsigned char)(c[k] / 3);
+	}
+}
+
+bool PreviewRenderer::render_mesh(int _size, std::vector<unsigned char>& _rgb) const
+{
+	std::vector<Vec3f> p;
+	std::vector<Vec2f> t;
+	if (_size <= 0 || !gather(p, t))
+		return false;
+	_rgb.assign(3 * _size * _size, BACKGROUND);
+	if (p.empty())
+		return true;
+
+	// view along the thinnest axis, the largest one across the image
+	Vec3f bb_min = p[0], bb_max = p[0];
+	for (size_t i = 1; i < p.size(); i++)
+	{
+		bb_min.minimize(p[i]);
+		bb_max.maximize(p[i]);
+	}
+	Vec3f extent = bb_max - bb_min;
+	int d1 = 0, d3 = 0;
+	for (int i = 1; i < 3; i++)
+	{
+		if (extent[i] > extent[d1])
+			d1 = i;
+		if (extent[i] < extent[d3])
+			d3 = i;
+	}
+	if (d1 == d3)
+		d3 = (d1 + 2) % 3;
+	int d2 = 3 - d1 - d3;
+
+	float margin = 0.05f * _size;
+	float scale = extent[d1] > 0.0f ? (_size - 2.0f * margin) / extent[d1] : 1.0f;
+	float ox = 0.5f * (_size - scale * extent[d1]);
+	float oy = 0.5f * (_size - scale * extent[d2]);
+
+	std::vector<float> depth(_size * _size, -std::numeric_limits<float>::max());
+	int nb_faces = (int)p.size() / 3;
+	for (int f = 0; f < nb_faces; f++)
+	{
+		float x[3], y[3], z[3];
+		for (int k = 0; k < 3; k++)
+		{
+			const Vec3f& q = p[3 * f + k];
+			x[k] = ox + scale * (q[d1] - bb_min[d1]);
+			y[k] = _size - (oy + scale * (q[d2] - bb_min[d2]));
+			z[k] = q[d3];
+		}
+		const Vec2f* tc = &t[3 * f];
+		fill_triangle(x, y, _size, [&](int _x, int _y, float _w0, float _w1, float _w2)
+		{
+			float d = _w0 * z[0] + _w1 * z[1] + _w2 * z[2];
+			float& zb = depth[_y * _size + _x];
+			if (d <= zb)
+				return;
+			zb = d;
+			float u = _w0 * tc[0][0] + _w1 * tc[1][0] + _w2 * tc[2][0];
+			float v = _w0 * tc[0][1] + _w1 * tc[1][1] + _w2 * tc[2][1];
+			unsigned char c = checker(u, v);
+			unsigned char* px = &_rgb[3 * (_y * _size + _x)];
+			px[0] = px[1] = px[2] = c;
+		});
+	}
+	return true;
+}
+
+bool PreviewRenderer::render_uv(int _size, std::vector<unsigned char>& _rgb) const
+{
+	std::vector<Vec3f> p;
+	std::vector<Vec2f> t;
+	if (_size <= 0 || !gather(p, t))
+		return false;
+	_rgb.assign(3 * _size * _size, BACKGROUND);
+	int nb_faces = (int)p.size() / 3;
+
+	// orientation of the majority, the others are flipped
+	std::vector<float> det(nb_faces);
+	double oriented = 0.0;
+	for (int f = 0; f < nb_faces; f++)
+	{
+		const Vec2f* tc = &t[3 * f];
+		det[f] = (tc[1][0] - tc[0][0]) * (tc[2][1] - tc[0][1]) -
+			(tc[2][0] - tc[0][0]) * (tc[1][1] - tc[0][1]);
+		oriented += det[f];
+	}
+	float sign = oriented < 0.0 ? -1.0f : 1.0f;
+
+	for (int f = 0; f < nb_faces; f++)
+	{
+		const Vec2f* tc = &t[3 * f];
+		float x[3], y[3];
+		for (int k = 0; k < 3; k++)
+		{
+			x[k] = tc[k][0] * _size;
+			y[k] = (1.0f - tc[k][1]) * _size;
+		}
+		bool flipped = det[f] * sign < 0.0f;
+		fill_triangle(x, y, _size, [&](int _x, int _y, float, float, float)
+		{
+			float u = (_x + 0.5f) / _size;
+			float v = 1.0f - (_y + 0.5f) / _size;
+			unsigned char c = checker(u, v);
+			unsigned char* px = &_rgb[3 * (_y * _size + _x)];
+			px[0] = c;
+			px[1] = px[2] = flipped ? c / 4 : c;
+		});
+	}
+
+	// edges only when a face covers a few pixels on average
+	if (nb_faces > 0 && nb_faces * 16 <= _size * _size)
+	{
+		for (int f = 0; f < nb_faces; f++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const Vec2f& a = t[3 * f + k];
+				const Vec2f& b = t[3 * f + (k + 1) % 3];
+				darken_line(a[0] * _size, (1.0f - a[1]) * _size,
+					b[0] * _size, (1.0f - b[1]) * _size, _size, _rgb);
+			}
+		}
+	}
+	return true;
+}
+
+// built before main, renderers on several threads only read it
+static struct CrcTable
+{
+	CrcTable()
+	{
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			unsigned int c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			value[i] = c;
+		}
+	}
+	unsigned int value[256];
+} crc_table;
+
+static unsigned int crc32(unsigned int _crc, const unsigned char* _data, size_t _n)
+{
+	_crc = ~_crc;
+	for (size_t i = 0; i < _n; i++)
+		_crc = crc_table.value[(_crc ^ _data[i]) & 0xff] ^ (_crc >> 8);
+	return ~_crc;
+}
+
+static void put32(std::vector<unsigned char>& _out, unsigned int _v)
+{
+	_out.push_back((unsigned char)(_v >> 24));
+	_out.push_back((unsigned char)(_v >> 16));
+	_out.push_back((unsigned char)(_v >> 8));
+	_out.push_back((unsigned char)_v);
+}
+
+static bool write_chunk(FILE* _f, const char* _type, const std::vector<unsigned char>& _data)
+{
+	std::vector<unsigned char> chunk;
+	put32(chunk, (unsigned int)_data.size());
+	chunk.insert(chunk.end(), _type, _type + 4);
+	chunk.insert(chunk.end(), _data.begin(), _data.end());
+	put32(chunk, crc32(0, &chunk[4], chunk.size() - 4));
+	return fwrite(&chunk[0], 1, chunk.size(), _f) == chunk.size();
+}
+
+// zlib stream of stored deflate blocks, every row starts with filter 0
+bool PreviewRenderer::write_png(const char* _filename, int _width, int _height,
+	const std::vector<unsigned char>& _rgb)
+{
+	if (_width <= 0 || _height <= 0 || _rgb.size() != 3 * (size_t)_width * _height)
+		return false;
+
+	std::vector<unsigned char> raw;
+	raw.reserve((3 * _width + 1) * _height);
+	for (int y = 0; y < _height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), _rgb.begin() + 3 * _width * y, _rgb.begin() + 3 * _width * (y + 1));
+	}
+
+	std::vector<unsigned char> idat;
+	idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+	size_t pos = 0;
+	do
+	{
+		size_t n = std::min(raw.size() - pos, (size_t)65535);
+		idat.push_back(pos + n == raw.size() ? 1 : 0);
+		idat.push_back((unsigned char)n);
+		idat.push_back((unsigned char)(n >> 8));
+		idat.push_back((unsigned char)~n);
+		idat.push_back((unsigned char)(~n >> 8));
+		idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + n);
+		pos += n;
+	} while (pos < raw.size());
+
+	unsigned int a = 1, b = 0;
+	for (size_t i = 0; i < raw.size(); i++)
+	{
+		a = (a + raw[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	put32(idat, (b << 16) | a);
+
+	std::vector<unsigned char> header;
+	put32(header, _width);
+	put32(header, _height);
+	header.push_back(8);  // bits per channel
+	header.push_back(2);  // RGB
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+
+	FILE* f = fopen(_filename, "wb");
+	if (!f)
+		return false;
+	static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	bool ok = fwrite(signature, 1, 8, f) == 8 &&
+		write_chunk(f, "IHDR", header) &&
+		write_chunk(f, "IDAT", idat) &&
+		write_chunk(f, "IEND", std::vector<unsigned char>());
+	return fclose(f) == 0 && ok;
+}
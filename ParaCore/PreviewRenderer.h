@@ -0,0 +1,40 @@
+#pragma once
+#include "MeshTypes.h"
+#include <vector>
+
+/// CPU rasterizer for QA thumbnails of a solved parameterization, no
+/// window system or GL context needed: the mesh textured with the
+/// checker of the viewer's "Texture" mode, and the UV layout. Images
+/// are square RGB, 3 bytes per pixel, top row first. One renderer
+/// runs on one thread, so batches render many meshes at once.
+class PreviewRenderer
+{
+public:
+	PreviewRenderer(const Mesh& _mesh);
+
+	/// read the per corner texcoords of an atlas (ChartAtlas) instead
+	/// of the vertex texcoords
+	void set_corners(bool _b) { corners_ = _b; }
+
+	/// The mesh seen along its thinnest bounding box axis, orthographic
+	/// and z-buffered, every face replaced by the checker like GL_DECAL
+	/// in the viewer. False without texcoords.
+	bool render_mesh(int _size, std::vector<unsigned char>& _rgb) const;
+
+	/// The [0,1]^2 texcoord square with the faces filled with the
+	/// checker, flipped faces tinted red and, if the faces are large
+	/// enough to see them, their edges drawn dark. False without
+	/// texcoords.
+	bool render_uv(int _size, std::vector<unsigned char>& _rgb) const;
+
+	/// 8 bit RGB PNG, stored without compression
+	static bool write_png(const char* _filename, int _width, int _height,
+		const std::vector<unsigned char>& _rgb);
+
+private:
+	bool gather(std::vector<Vec3f>& _p, std::vector<Vec2f>& _t) const;
+
+private:
+	const Mesh& mesh_;
+	bool corners_;
+};
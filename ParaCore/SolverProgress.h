@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <functional>
+
+/// Progress of a running solve, written by the solver thread and
+/// polled by any other thread. cancel() asks the solver to stop at
+/// its next iteration, the solve then reports failure.
+///
+/// It also carries the stopping criteria of the parallel CG backends
+/// and a callback that receives every iteration. Both are set before
+/// the solve starts and are kept by reset().
+class SolverProgress
+{
+public:
+	/// why the last CG solve stopped
+	enum Stop
+	{
+		STOP_NONE,        ///< not stopped yet
+		STOP_RESIDUAL,    ///< relative residual below the tolerance
+		STOP_CHANGE,      ///< (u,v) change per iteration below the minimum
+		STOP_TIME,        ///< time limit reached, the result is usable
+		STOP_ITERATIONS,  ///< iteration cap reached
+		STOP_CANCELLED    ///< cancel(), the result is dropped
+	};
+
+	/// iteration, relative residual and relative (u,v) change, called
+	/// from the solver thread
+	typedef std::function<void(int _it, double _residual, double _change)> Callback;
+
+public:
+	SolverProgress() : tolerance_(1e-10), min_change_(0.0), time_limit_(0.0) { reset(); }
+
+	void reset()
+	{
+		cancel_ = false;
+		iteration_ = 0;
+		residual_ = 0.0;
+		stop_ = STOP_NONE;
+		charts_done_ = 0;
+		charts_total_ = 0;
+	}
+
+	void cancel() { cancel_ = true; }
+	bool cancelled() const { return cancel_; }
+
+	/// current CG iteration and relative residual
+	void set_iteration(int _it, double _residual)
+	{
+		iteration_ = _it;
+		residual_ = _residual;
+	}
+	int iteration() const { return iteration_; }
+	double residual() const { return residual_; }
+
+	void set_stop(Stop _stop) { stop_ = _stop; }
+	Stop stop() const { return (Stop)stop_.load(); }
+
+	/// stop once the residual relative to the right hand side is
+	/// below _tolerance, the OpenNL backends use it as well
+	void set_tolerance(double _tolerance) { tolerance_ = _tolerance; }
+	double tolerance() const { return tolerance_; }
+
+	/// stop once an iteration changes the (u,v) by less than
+	/// _min_change (RMS) times the distance of the pins, 0 disables it
+	void set_min_change(double _min_change) { min_change_ = _min_change; }
+	double min_change() const { return min_change_; }
+
+	/// stop after _seconds and keep the current solution, 0 disables it
+	void set_time_limit(double _seconds) { time_limit_ = _seconds; }
+	double time_limit() const { return time_limit_; }
+
+	void set_callback(const Callback& _callback) { callback_ = _callback; }
+	const Callback& callback() const { return callback_; }
+
+	/// finished charts of a multi-chart solve
+	void set_charts(int _done, int _total)
+	{
+		charts_done_ = _done;
+		charts_total_ = _total;
+	}
+	void add_chart() { ++charts_done_; }
+	int charts_done() const { return charts_done_; }
+	int charts_total() const { return charts_total_; }
+
+private:
+	std::atomic<bool> cancel_;
+	std::atomic<int> iteration_;
+	std::atomic<double> residual_;
+	std::atomic<int> stop_;
+	std::atomic<int> charts_done_;
+	std::atomic<int> charts_total_;
+
+	double tolerance_;
+	double min_change_;
+	double time_limit_;
+	Callback callback_;
+};
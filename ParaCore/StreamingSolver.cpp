@@ -0,0 +1,466 @@
+#include "StreamingSolver.h"
+#include "BinaryMesh.h"
+#include "ObjWriter.h"
+#include "Telemetry.h"
+#include "TriangleKernel.h"
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+// x, r, p, q and the inverse diagonal
+static const int N_VECTORS = 5;
+
+static size_t align64(size_t _bytes)
+{
+	return (_bytes + 63) & ~(size_t)63;
+}
+
+
+StreamingSolver::StreamingSolver() :
+memory_budget_(0.0), progress_(NULL), telemetry_(NULL),
+n_vertices_(0), n_faces_(0), used_iterations_(0), solver_time_(0.0), vectors_mapped_(false),
+points_(NULL), indices_(NULL), coefs_(NULL), vectors_(NULL)
+{
+	pins_[0] = pins_[1] = -1;
+}
+
+void StreamingSolver::stage(const char* _name)
+{
+	if (!telemetry_)
+		return;
+	if (_name)
+		telemetry_->begin(_name);
+	else
+		telemetry_->end();
+}
+
+bool StreamingSolver::solve(const char* _in, const char* _out)
+{
+	used_iterations_ = 0;
+	solver_time_ = 0.0;
+
+	stage("load");
+	BinaryMesh mesh;
+	if (!mesh.open(_in))
+	{
+		std::cerr << _in << ": cannot read binary mesh\n";
+		return false;
+	}
+	n_vertices_ = mesh.n_vertices();
+	n_faces_ = mesh.n_faces();
+	if (n_vertices_ < 3 || n_faces_ < 1)
+	{
+		std::cerr << _in << ": no faces\n";
+		return false;
+	}
+	points_ = mesh.points();
+	indices_ = mesh.indices();
+
+	// the coefficients always go to the scratch file, the vectors only
+	// if they do not fit in the budget
+	size_t n = 2 * (size_t)n_vertices_;
+	size_t coef_bytes = align64(3 * (size_t)n_faces_ * sizeof(float));
+	size_t vector_bytes = N_VECTORS * n * sizeof(double);
+	vectors_mapped_ = memory_budget_ > 0.0 && vector_bytes > memory_budget_ * 1024.0 * 1024.0;
+
+	std::string scratch = scratch_name_.empty() ? std::string(_out) + ".scratch" : scratch_name_;
+	if (!scratch_.create(scratch.c_str(), coef_bytes + (vectors_mapped_ ? vector_bytes : 0)))
+	{
+		std::cerr << scratch << ": cannot create scratch file\n";
+		return false;
+	}
+	coefs_ = (float*)scratch_.writable();
+	if (vectors_mapped_)
+		vectors_ = (double*)(scratch_.writable() + coef_bytes);
+	else
+	{
+		heap_vectors_.assign(N_VECTORS * n, 0.0);
+		vectors_ = &heap_vectors_[0];
+	}
+
+	stage("project");
+	project(mesh.bb_min(), mesh.bb_max());
+
+	stage("assemble");
+	bool ok = assemble();
+	if (ok)
+	{
+		stage("solve");
+		double t0 = omp_get_wtime();
+		used_iterations_ = solve_cg();
+		solver_time_ = omp_get_wtime() - t0;
+		ok = !(progress_ && progress_->cancelled());
+	}
+	if (ok)
+	{
+		stage("write");
+		ok = write(_out);
+	}
+	stage(NULL);
+	if (telemetry_)
+	{
+		telemetry_->set_counter("vertices", n_vertices_);
+		telemetry_->set_counter("faces", n_faces_);
+		telemetry_->set_counter("iterations", used_iterations_);
+		telemetry_->set_counter("vectors_mapped", vectors_mapped_ ? 1 : 0);
+	}
+
+	std::vector<double>().swap(heap_vectors_);
+	scratch_.close();
+	std::remove(scratch.c_str());
+	points_ = NULL;
+	indices_ = NULL;
+	coefs_ = NULL;
+	vectors_ = NULL;
+	return ok;
+}
+
+// Same axes and pins as LSCMSolver::init_slover without a boundary:
+// the projection on the two largest axes of the bounding box, pinned
+// at the extremes of the largest
+void StreamingSolver::project(const Mesh::Point& _bb_min, const Mesh::Point& _bb_max)
+{
+	Mesh::Point axis = _bb_max - _bb_min;
+	int d1, d2, d3;
+	d1 = d2 = d3 = 0;
+	for (int i = 1; i < 3; i++)
+	{
+		if (axis[i] > axis[d1])
+			d1 = i;
+		if (axis[i] < axis[d3])
+			d3 = i;
+	}
+	for (d2 = 0; d2 < 3; d2++)
+	{
+		if (d2 != d1 && d2 != d3)
+			break;
+	}
+
+	double* x = vectors_;
+	float u1 = -1.0e30f, u2 = 1.0e30f;
+	int lock1 = 0, lock2 = 0;
+	for (int idx = 0; idx < n_vertices_; idx++)
+	{
+		float u = points_[idx][d1];
+		float v = points_[idx][d2];
+		x[2 * idx] = u;
+		x[2 * idx + 1] = v;
+		if (u > u1)
+		{
+			lock1 = idx;
+			u1 = u;
+		}
+		if (u < u2)
+		{
+			lock2 = idx;
+			u2 = u;
+		}
+	}
+	pins_[0] = lock1;
+	pins_[1] = lock2;
+}
+
+bool StreamingSolver::assemble()
+{
+	int nb_blocks = (n_faces_ + FACE_BLOCK - 1) / FACE_BLOCK;
+	int bad = 0;
+#pragma omp parallel for schedule(static) reduction(+:bad)
+	for (int blk = 0; blk < nb_blocks; blk++)
+	{
+		int f0 = blk * FACE_BLOCK;
+		int n = std::min((int)FACE_BLOCK, n_faces_ - f0);
+
+		float px[3][FACE_BLOCK], py[3][FACE_BLOCK], pz[3][FACE_BLOCK];
+		for (int i = 0; i < n; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices_[3 * (f0 + i) + k];
+				if (v >= (unsigned int)n_vertices_)
+				{
+					bad++;
+					v = 0;
+				}
+				const Mesh::Point& p = points_[v];
+				px[k][i] = p[0];
+				py[k][i] = p[1];
+				pz[k][i] = p[2];
+			}
+		}
+
+		TriangleCorners t = { { px[0], px[1], px[2] },
+		                      { py[0], py[1], py[2] },
+		                      { pz[0], pz[1], pz[2] } };
+		float fa[FACE_BLOCK], fc[FACE_BLOCK], fd[FACE_BLOCK];
+		project_triangles(t, n, fa, fc, fd);
+
+		for (int i = 0; i < n; i++)
+		{
+			float* coef = &coefs_[3 * (f0 + i)];
+			coef[0] = fa[i];
+			coef[1] = fc[i];
+			coef[2] = fd[i];
+		}
+	}
+	if (bad)
+	{
+		std::cerr << "StreamingSolver: " << bad << " vertex indices out of range\n";
+		return false;
+	}
+	return true;
+}
+
+// The two rows of every face (see LSCMSystem::multiply_free), then
+// their columns scattered to the corners. Faces of different threads
+// share vertices, so the scatter is atomic.
+void StreamingSolver::multiply(const double* _x, double* _y, bool _pins_only) const
+{
+	int n = 2 * n_vertices_;
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < n; j++)
+		_y[j] = 0.0;
+
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < n_faces_; f++)
+	{
+		const float* coef = &coefs_[3 * f];
+		const unsigned int* id = &indices_[3 * f];
+		double a = coef[0], c = coef[1], d = coef[2];
+		if (a == 0.0 && c == 0.0 && d == 0.0)
+			continue;
+
+		double u[3], v[3];
+		for (int k = 0; k < 3; k++)
+		{
+			int j = 2 * id[k];
+			bool used = !_pins_only || locked(j);
+			u[k] = used ? _x[j] : 0.0;
+			v[k] = used ? _x[j + 1] : 0.0;
+		}
+		double re = (c - a) * u[0] - d * v[0] - c * u[1] + d * v[1] + a * u[2];
+		double im = d * u[0] + (c - a) * v[0] - d * u[1] - c * v[1] + a * v[2];
+
+		double su[3] = { (c - a) * re + d * im, -(c * re + d * im), a * re };
+		double sv[3] = { (c - a) * im - d * re, d * re - c * im, a * im };
+		for (int k = 0; k < 3; k++)
+		{
+			int j = 2 * id[k];
+#pragma omp atomic
+			_y[j] += su[k];
+#pragma omp atomic
+			_y[j + 1] += sv[k];
+		}
+	}
+}
+
+void StreamingSolver::inverse_diagonal(double* _d) const
+{
+	int n = 2 * n_vertices_;
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < n; j++)
+		_d[j] = 0.0;
+
+	// u and v of a corner see the same two coefficients
+#pragma omp parallel for schedule(static)
+	for (int f = 0; f < n_faces_; f++)
+	{
+		const float* coef = &coefs_[3 * f];
+		const unsigned int* id = &indices_[3 * f];
+		double a = coef[0], c = coef[1], d = coef[2];
+		double s[3] = { (c - a) * (c - a) + d * d, c * c + d * d, a * a };
+		for (int k = 0; k < 3; k++)
+		{
+			int j = 2 * id[k];
+#pragma omp atomic
+			_d[j] += s[k];
+#pragma omp atomic
+			_d[j + 1] += s[k];
+		}
+	}
+
+#pragma omp parallel for schedule(static)
+	for (int j = 0; j < n; j++)
+	{
+		double s = _d[j];
+		_d[j] = (locked(j) || s == 0.0) ? 0.0 : 1.0 / s;
+	}
+}
+
+// LSCMSystem::solve_cg with z = inv_diag * r computed on the fly, so
+// five vectors instead of seven
+int StreamingSolver::solve_cg()
+{
+	int n = 2 * n_vertices_;
+	double* x = vectors_;
+	double* r = vectors_ + (size_t)n;
+	double* p = vectors_ + 2 * (size_t)n;
+	double* q = vectors_ + 3 * (size_t)n;
+	double* inv_diag = vectors_ + 4 * (size_t)n;
+
+	inverse_diagonal(inv_diag);
+
+	// right hand side b = -A^T A x_locked, only used for the threshold
+	multiply(x, q, true);
+	double bb = 0.0;
+#pragma omp parallel for reduction(+:bb)
+	for (int j = 0; j < n; j++)
+	{
+		if (!locked(j))
+			bb += q[j] * q[j];
+	}
+
+	// r = b - A^T A x_free = -A^T A x
+	multiply(x, r, false);
+	double rz = 0.0, rr = 0.0;
+#pragma omp parallel for reduction(+:rz,rr)
+	for (int j = 0; j < n; j++)
+	{
+		r[j] = locked(j) ? 0.0 : -r[j];
+		p[j] = inv_diag[j] * r[j];
+		rz += r[j] * p[j];
+		rr += r[j] * r[j];
+	}
+
+	// the spread of the two pins sets the scale of the map
+	double t0 = omp_get_wtime();
+	const double* x0 = &x[2 * pins_[0]];
+	const double* x1 = &x[2 * pins_[1]];
+	double scale = std::max(std::fabs(x0[0] - x1[0]), std::fabs(x0[1] - x1[1]));
+	if (scale <= 0.0)
+		scale = 1.0;
+	int nb_free = n - 4;
+
+	double threshold = progress_ ? progress_->tolerance() : 1e-10;
+	double err = threshold * threshold * bb;
+	int max_iter = 5 * n_vertices_;
+	int it = 0;
+	SolverProgress::Stop stop = SolverProgress::STOP_ITERATIONS;
+	while (it < max_iter)
+	{
+		if (rr <= err)
+		{
+			stop = SolverProgress::STOP_RESIDUAL;
+			break;
+		}
+
+		multiply(p, q, false);
+
+		double pq = 0.0, pp = 0.0;
+#pragma omp parallel for reduction(+:pq,pp)
+		for (int j = 0; j < n; j++)
+		{
+			if (locked(j))
+				q[j] = 0.0;
+			pq += p[j] * q[j];
+			pp += p[j] * p[j];
+		}
+		if (pq <= 0.0)
+		{
+			stop = SolverProgress::STOP_RESIDUAL;
+			break;
+		}
+		double alpha = rz / pq;
+
+		double rz_new = 0.0;
+		rr = 0.0;
+#pragma omp parallel for reduction(+:rz_new,rr)
+		for (int j = 0; j < n; j++)
+		{
+			x[j] += alpha * p[j];
+			r[j] -= alpha * q[j];
+			rz_new += r[j] * inv_diag[j] * r[j];
+			rr += r[j] * r[j];
+		}
+
+		double beta = rz_new / rz;
+		rz = rz_new;
+#pragma omp parallel for schedule(static)
+		for (int j = 0; j < n; j++)
+			p[j] = inv_diag[j] * r[j] + beta * p[j];
+
+		++it;
+
+		if (progress_)
+		{
+			double residual = bb > 0.0 ? std::sqrt(rr / bb) : 0.0;
+			double change = nb_free > 0 ? std::fabs(alpha) * std::sqrt(pp / nb_free) / scale : 0.0;
+			progress_->set_iteration(it, residual);
+			if (progress_->callback())
+				progress_->callback()(it, residual, change);
+
+			if (progress_->cancelled())
+			{
+				stop = SolverProgress::STOP_CANCELLED;
+				break;
+			}
+			if (change < progress_->min_change())
+			{
+				stop = SolverProgress::STOP_CHANGE;
+				break;
+			}
+			if (progress_->time_limit() > 0.0 && omp_get_wtime() - t0 > progress_->time_limit())
+			{
+				stop = SolverProgress::STOP_TIME;
+				break;
+			}
+		}
+	}
+	if (it == max_iter && rr <= err)
+		stop = SolverProgress::STOP_RESIDUAL;
+
+	if (progress_)
+		progress_->set_stop(stop);
+	return it;
+}
+
+// Normalized like LSCMSolver::get_result, formatted and written one
+// block of vertices at a time
+bool StreamingSolver::write(const char* _out) const
+{
+	const double* x = vectors_;
+	float lo[2] = { (float)x[0], (float)x[1] }, hi[2] = { lo[0], lo[1] };
+	for (int i = 0; i < n_vertices_; i++)
+	{
+		for (int k = 0; k < 2; k++)
+		{
+			float u = (float)x[2 * i + k];
+			lo[k] = std::min(lo[k], u);
+			hi[k] = std::max(hi[k], u);
+		}
+	}
+	double dx = std::max((double)hi[0] - lo[0], (double)hi[1] - lo[1]);
+
+	FILE* file = fopen(_out, "wb");
+	if (!file)
+	{
+		std::cerr << _out << ": cannot write file\n";
+		return false;
+	}
+	fprintf(file, "# uv vertex %d\n", n_vertices_);
+
+	std::vector<char> buffer((size_t)VERTEX_BLOCK * ObjWriter::MAX_TEXCOORD_LINE);
+	bool ok = true;
+	for (int v0 = 0; ok && v0 < n_vertices_; v0 += VERTEX_BLOCK)
+	{
+		int v1 = std::min((int)n_vertices_, v0 + VERTEX_BLOCK);
+		char* out = &buffer[0];
+		for (int v = v0; v < v1; v++)
+		{
+			float uv[2];
+			for (int k = 0; k < 2; k++)
+				uv[k] = (float)(((float)x[2 * v + k] - lo[k]) / dx);
+			out = ObjWriter::format_texcoord(uv, out);
+		}
+		size_t size = out - &buffer[0];
+		ok = fwrite(&buffer[0], 1, size, file) == size;
+	}
+
+	if (fclose(file) != 0 || !ok)
+	{
+		std::cerr << _out << ": cannot write file\n";
+		return false;
+	}
+	return true;
+}
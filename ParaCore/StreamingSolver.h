@@ -0,0 +1,91 @@
+#pragma once
+#include "MeshTypes.h"
+#include "SolverProgress.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+class Telemetry;
+
+/// Out-of-core LSCM for meshes too large for LSCMSolver. The .pmesh
+/// input is mapped and read in place (see BinaryMesh), the a, c, d of
+/// every face go to a memory mapped scratch file, and the Jacobi CG of
+/// LSCMSystem runs matrix free, streaming once over the faces per
+/// iteration. Nothing proportional to the faces is kept on the heap.
+///
+/// The CG vectors (5 doubles per unknown) stay on the heap if they fit
+/// in the memory budget, else they are mapped from the scratch file as
+/// well and the OS pages them. The pins are the extremes of the
+/// projection on the largest axis of the bounding box, the initial
+/// guess is that projection. The result is normalized like LSCMSolver's
+/// and written as a vertex UV sidecar (see ObjWriter::write_uv), one
+/// block of vertices at a time.
+class StreamingSolver
+{
+public:
+	/// faces projected per block, vertices written per block
+	enum { FACE_BLOCK = 64, VERTEX_BLOCK = 1 << 14 };
+
+public:
+	StreamingSolver();
+
+	/// heap memory of the CG vectors, 0: unlimited
+	void set_memory_budget(double _mb) { memory_budget_ = _mb; }
+	/// scratch file, removed after the solve. By default the output
+	/// name followed by ".scratch".
+	void set_scratch(const std::string& _filename) { scratch_name_ = _filename; }
+	void set_progress(SolverProgress* _progress) { progress_ = _progress; }
+	void set_telemetry(Telemetry* _telemetry) { telemetry_ = _telemetry; }
+
+	/// parameterizes the .pmesh _in and writes the UV sidecar _out
+	bool solve(const char* _in, const char* _out);
+
+	int n_vertices() const { return n_vertices_; }
+	int n_faces() const { return n_faces_; }
+	int used_iterations() const { return used_iterations_; }
+	double solver_time() const { return solver_time_; }
+	/// the CG vectors did not fit in the budget
+	bool vectors_mapped() const { return vectors_mapped_; }
+
+private:
+	/// begin stage _name of the telemetry, NULL ends the running one
+	void stage(const char* _name);
+
+	/// pins and initial guess
+	void project(const Mesh::Point& _bb_min, const Mesh::Point& _bb_max);
+	/// a, c, d of every face to the scratch file, false on a bad index
+	bool assemble();
+	/// y = A^T A x, only the pinned entries of x with _pins_only
+	void multiply(const double* _x, double* _y, bool _pins_only) const;
+	/// Jacobi preconditioner, 0 for the pinned unknowns
+	void inverse_diagonal(double* _d) const;
+	int solve_cg();
+	bool write(const char* _out) const;
+
+	bool locked(int _j) const { return (_j >> 1) == pins_[0] || (_j >> 1) == pins_[1]; }
+
+private:
+	double memory_budget_;
+	std::string scratch_name_;
+	SolverProgress* progress_;
+	Telemetry* telemetry_;
+
+	int n_vertices_, n_faces_;
+	int used_iterations_;
+	double solver_time_;
+	bool vectors_mapped_;
+
+	// input, in place
+	const Mesh::Point* points_;
+	const unsigned int* indices_;
+	int pins_[2];
+
+	// a, c, d of face f at 3f, in the scratch file
+	MappedFile scratch_;
+	float* coefs_;
+
+	// x, r, p, q and the inverse diagonal, on the heap or after the
+	// coefficients in the scratch file
+	double* vectors_;
+	std::vector<double> heap_vectors_;
+};
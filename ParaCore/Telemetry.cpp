@@ -0,0 +1,216 @@
+#include "Telemetry.h"
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <omp.h>
+
+#if defined(_WIN32)
+#  define NOMINMAX
+#  include <windows.h>
+#  include <psapi.h>
+#else
+#  include <sys/resource.h>
+#  include <unistd.h>
+#  include <cstdio>
+#  if defined(__APPLE__)
+#    include <mach/mach.h>
+#  endif
+#endif
+
+// written by the operator new of AllocationCounter.cpp, if linked.
+// The flag is set during static initialization, so it is a plain bool
+// that is initialized before any constructor runs.
+static std::atomic<long long> allocation_count(0);
+static bool allocation_count_enabled = false;
+
+
+Telemetry::Telemetry() :
+running_(false), wall_start_(0.0), cpu_start_(0.0), allocations_start_(0)
+{
+}
+
+void Telemetry::begin(const char* _name)
+{
+	end();
+	Stage stage;
+	stage.name = _name;
+	stage.start = stage.wall = stage.cpu = stage.peak_mb = 0.0;
+	stage.allocations = 0;
+	stages_.push_back(stage);
+	if (probe_)
+		probe_();
+
+	running_ = true;
+	allocations_start_ = allocations();
+	cpu_start_ = cpu_time();
+	wall_start_ = stages_.back().start = omp_get_wtime();
+}
+
+void Telemetry::end()
+{
+	if (!running_)
+		return;
+	Stage& stage = stages_.back();
+	stage.wall = omp_get_wtime() - wall_start_;
+	stage.cpu = cpu_time() - cpu_start_;
+	stage.allocations = allocations() - allocations_start_;
+	stage.peak_mb = probe_ ? probe_() : peak_memory_mb();
+	running_ = false;
+}
+
+void Telemetry::clear()
+{
+	stages_.clear();
+	counters_.clear();
+	running_ = false;
+}
+
+void Telemetry::set_counter(const char* _name, double _value)
+{
+	for (size_t i = 0; i < counters_.size(); i++)
+	{
+		if (counters_[i].first == _name)
+		{
+			counters_[i].second = _value;
+			return;
+		}
+	}
+	counters_.push_back(std::make_pair(std::string(_name), _value));
+}
+
+double Telemetry::total() const
+{
+	double t = 0.0;
+	for (size_t i = 0; i < stages_.size(); i++)
+		t += stages_[i].wall;
+	return t;
+}
+
+// JSON has no nan or inf, and counters such as faces or nonzeros must
+// not be rounded to 6 digits
+static void write_number(std::ostream& _out, double _value)
+{
+	if (!std::isfinite(_value))
+		_out << "null";
+	else if (_value == std::floor(_value) && std::fabs(_value) < 9.0e15)
+		_out << static_cast<long long>(_value);
+	else
+		_out << std::setprecision(17) << _value;
+}
+
+std::string Telemetry::json() const
+{
+	std::ostringstream out;
+	out << "{\"stages\":[";
+	for (size_t i = 0; i < stages_.size(); i++)
+	{
+		const Stage& s = stages_[i];
+		out << (i ? "," : "") << "{\"name\":\"" << s.name << "\",\"wall_s\":";
+		write_number(out, s.wall);
+		out << ",\"cpu_s\":";
+		write_number(out, s.cpu);
+		if (counts_allocations())
+			out << ",\"allocations\":" << s.allocations;
+		out << ",\"peak_mb\":";
+		write_number(out, s.peak_mb);
+		out << "}";
+	}
+	out << "],\"total_s\":";
+	write_number(out, total());
+	out << ",\"counters\":{";
+	for (size_t i = 0; i < counters_.size(); i++)
+	{
+		out << (i ? "," : "") << "\"" << counters_[i].first << "\":";
+		write_number(out, counters_[i].second);
+	}
+	out << "}}";
+	return out.str();
+}
+
+double Telemetry::cpu_time()
+{
+#if defined(_WIN32)
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0.0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) * 1.0e-7;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+		(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+#endif
+}
+
+double Telemetry::peak_memory_mb()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0.0;
+	return pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+#  if defined(__APPLE__)
+	return usage.ru_maxrss / (1024.0 * 1024.0);
+#  else
+	return usage.ru_maxrss / 1024.0;
+#  endif
+#endif
+}
+
+double Telemetry::current_memory_mb()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0.0;
+	return pmc.WorkingSetSize / (1024.0 * 1024.0);
+#elif defined(__APPLE__)
+	mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+		return 0.0;
+	return info.resident_size / (1024.0 * 1024.0);
+#else
+	// second field of statm: resident pages
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0.0;
+	long size = 0, resident = 0;
+	int n = fscanf(file, "%ld %ld", &size, &resident);
+	fclose(file);
+	if (n != 2)
+		return 0.0;
+	return resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+#endif
+}
+
+long long Telemetry::allocations()
+{
+	return allocation_count.load(std::memory_order_relaxed);
+}
+
+bool Telemetry::counts_allocations()
+{
+	return allocation_count_enabled;
+}
+
+void Telemetry::count_allocation()
+{
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Telemetry::enable_allocation_count()
+{
+	allocation_count_enabled = true;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Wall time, CPU time, heap allocations and peak memory per named
+/// stage of a run, and counters such as faces, nonzeros and
+/// iterations, reported as one JSON line. CPU time, allocations and
+/// peak memory are those of the whole process, so stages of runs on
+/// other threads count towards each other.
+///
+/// Allocations are only counted in programs that link
+/// AllocationCounter.cpp, which replaces the global operator new and
+/// delete (para_cli and para_bench do), else they are left out of the
+/// report. malloc, and so OpenNL's matrix, is never counted.
+class Telemetry
+{
+public:
+	struct Stage
+	{
+		std::string name;
+		double start;       ///< omp_get_wtime() at begin()
+		double wall;        ///< s
+		double cpu;         ///< s, all threads
+		long long allocations;
+		double peak_mb;     ///< peak of the process when the stage ends, or of the probe
+	};
+
+	/// memory in MB since its last call, such as the highest sample of
+	/// a sampling thread
+	typedef std::function<double()> MemoryProbe;
+
+public:
+	Telemetry();
+
+	/// start stage _name, a running stage ends first
+	void begin(const char* _name);
+	/// end the running stage, if any
+	void end();
+	void clear();
+
+	/// Called when a stage begins and ends, the peak of a stage is then
+	/// what the probe returns at its end instead of the peak of the
+	/// process so far, so that a stage freeing what the previous one
+	/// allocated reports less. Empty (the default) disables it.
+	void set_memory_probe(const MemoryProbe& _probe) { probe_ = _probe; }
+
+	/// set or replace a counter
+	void set_counter(const char* _name, double _value);
+
+	const std::vector<Stage>& stages() const { return stages_; }
+	/// wall time of all stages
+	double total() const;
+
+	/// {"stages":[{"name":..., "wall_s":..., ...}, ...], "counters":{...}}
+	std::string json() const;
+
+	/// CPU time of the process, s
+	static double cpu_time();
+	/// peak working set of the process, MB
+	static double peak_memory_mb();
+	/// working set of the process now, MB
+	static double current_memory_mb();
+	/// operator new calls of the process so far, 0 if not counted
+	static long long allocations();
+	static bool counts_allocations();
+	/// called by the replaced operator new
+	static void count_allocation();
+	static void enable_allocation_count();
+
+private:
+	std::vector<Stage> stages_;
+	std::vector<std::pair<std::string, double> > counters_;
+	MemoryProbe probe_;
+
+	// running stage
+	bool running_;
+	double wall_start_, cpu_start_;
+	long long allocations_start_;
+};
@@ -0,0 +1,111 @@
+#include "TriangleKernel.h"
+#include <immintrin.h>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#  define TARGET_AVX2
+#else
+#  define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+
+// With X = p1 - p0 and E = p2 - p0, the basis of the original
+// project_triangle reduces to
+//   a = |X|,  c = X.E / |X|,  d = |X x E| / |X|
+void project_triangles_scalar(const TriangleCorners& _t, int _begin, int _end,
+	float* _a, float* _c, float* _d)
+{
+	for (int i = _begin; i < _end; i++)
+	{
+		float ex = _t.x[1][i] - _t.x[0][i];
+		float ey = _t.y[1][i] - _t.y[0][i];
+		float ez = _t.z[1][i] - _t.z[0][i];
+		float fx = _t.x[2][i] - _t.x[0][i];
+		float fy = _t.y[2][i] - _t.y[0][i];
+		float fz = _t.z[2][i] - _t.z[0][i];
+
+		float cx = ey * fz - ez * fy;
+		float cy = ez * fx - ex * fz;
+		float cz = ex * fy - ey * fx;
+
+		float a = std::sqrt(ex * ex + ey * ey + ez * ez);
+		float inv = a > 0.0f ? 1.0f / a : 0.0f;
+		_a[i] = a;
+		_c[i] = (ex * fx + ey * fy + ez * fz) * inv;
+		_d[i] = std::sqrt(cx * cx + cy * cy + cz * cz) * inv;
+	}
+}
+
+TARGET_AVX2
+static void project_triangles_avx2(const TriangleCorners& _t, int _n,
+	float* _a, float* _c, float* _d)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	int i = 0;
+	for (; i + 8 <= _n; i += 8)
+	{
+		__m256 x0 = _mm256_loadu_ps(_t.x[0] + i);
+		__m256 y0 = _mm256_loadu_ps(_t.y[0] + i);
+		__m256 z0 = _mm256_loadu_ps(_t.z[0] + i);
+
+		__m256 ex = _mm256_sub_ps(_mm256_loadu_ps(_t.x[1] + i), x0);
+		__m256 ey = _mm256_sub_ps(_mm256_loadu_ps(_t.y[1] + i), y0);
+		__m256 ez = _mm256_sub_ps(_mm256_loadu_ps(_t.z[1] + i), z0);
+		__m256 fx = _mm256_sub_ps(_mm256_loadu_ps(_t.x[2] + i), x0);
+		__m256 fy = _mm256_sub_ps(_mm256_loadu_ps(_t.y[2] + i), y0);
+		__m256 fz = _mm256_sub_ps(_mm256_loadu_ps(_t.z[2] + i), z0);
+
+		__m256 cx = _mm256_fmsub_ps(ey, fz, _mm256_mul_ps(ez, fy));
+		__m256 cy = _mm256_fmsub_ps(ez, fx, _mm256_mul_ps(ex, fz));
+		__m256 cz = _mm256_fmsub_ps(ex, fy, _mm256_mul_ps(ey, fx));
+
+		__m256 ee = _mm256_fmadd_ps(ez, ez, _mm256_fmadd_ps(ey, ey, _mm256_mul_ps(ex, ex)));
+		__m256 ef = _mm256_fmadd_ps(ez, fz, _mm256_fmadd_ps(ey, fy, _mm256_mul_ps(ex, fx)));
+		__m256 cc = _mm256_fmadd_ps(cz, cz, _mm256_fmadd_ps(cy, cy, _mm256_mul_ps(cx, cx)));
+
+		__m256 a = _mm256_sqrt_ps(ee);
+		__m256 inv = _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_GT_OQ),
+			_mm256_div_ps(one, a));
+
+		_mm256_storeu_ps(_a + i, a);
+		_mm256_storeu_ps(_c + i, _mm256_mul_ps(ef, inv));
+		_mm256_storeu_ps(_d + i, _mm256_mul_ps(_mm256_sqrt_ps(cc), inv));
+	}
+	_mm256_zeroupper();
+
+	project_triangles_scalar(_t, i, _n, _a, _c, _d);
+}
+
+bool has_avx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool fma = (info[2] & (1 << 12)) != 0;
+	if (!osxsave || !fma || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+// resolved once at load time, before any worker thread runs
+static const bool s_avx2 = has_avx2();
+
+void project_triangles(const TriangleCorners& _t, int _n,
+	float* _a, float* _c, float* _d)
+{
+	if (s_avx2)
+		project_triangles_avx2(_t, _n, _a, _c, _d);
+	else
+		project_triangles_scalar(_t, 0, _n, _a, _c, _d);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+/// Triangle corners in structure-of-arrays layout: corner k of
+/// triangle i is (x[k][i], y[k][i], z[k][i]).
+struct TriangleCorners
+{
+	const float* x[3];
+	const float* y[3];
+	const float* z[3];
+};
+
+/// Local 2D frame of n triangles. With p0 at the origin and p1 on the
+/// x axis the corners project to z0 = (0,0), z1 = (a,0), z2 = (c,d),
+/// which are exactly the terms of the LSCM relations. Degenerate
+/// triangles (p0 == p1) get a = c = d = 0.
+/// Runs 8 triangles per instruction on AVX2 CPUs, scalar otherwise.
+void project_triangles(const TriangleCorners& _t, int _n,
+	float* _a, float* _c, float* _d);
+
+/// scalar reference of project_triangles
+void project_triangles_scalar(const TriangleCorners& _t, int _begin, int _end,
+	float* _a, float* _c, float* _d);
+
+/// true if the CPU and the OS support AVX2
+bool has_avx2();
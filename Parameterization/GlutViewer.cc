@@ -437,6 +437,12 @@ void GlutViewer::set_draw_mode(int _id)
 void GlutViewer::passivemotion(int x, int y) {}
 void GlutViewer::visibility(int visible) {}
 void GlutViewer::idle(void) {} 
+void GlutViewer::timer(int _value) {}
+
+void GlutViewer::start_timer(int _msecs, int _value)
+{
+	glutTimerFunc(_msecs, timer__, _value);
+}
 
 
 // -----------
@@ -477,6 +483,10 @@ void GlutViewer::visibility__(int visible) {
 	current_viewer_->visibility(visible);
 }
 
+void GlutViewer::timer__(int value) {
+	current_viewer_->timer(value);
+}
+
 void GlutViewer::processmenu__(int id) {
 	current_viewer_->processmenu(id);
 }
@@ -36,6 +36,10 @@ protected:
 	virtual void passivemotion(int x, int y);
 	virtual void visibility(int visible);
 	virtual void idle(void); 
+	virtual void timer(int _value);
+
+	/// call timer(_value) once, _msecs from now
+	void start_timer(int _msecs, int _value = 0);
 
 
 	void clear_draw_modes();
@@ -61,6 +65,7 @@ private:
 	static void reshape__(int w, int h); 
 	static void special__(int key, int x, int y);   
 	static void visibility__(int visible);
+	static void timer__(int value);
 	static void processmenu__(int i); 
 
 protected:
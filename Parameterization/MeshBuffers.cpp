@@ -0,0 +1,232 @@
+#include "MeshBuffers.h"
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(ARCH_DARWIN)
+#  include <GL/glx.h>
+#endif
+
+#ifndef GL_ARRAY_BUFFER
+#  define GL_ARRAY_BUFFER         0x8892
+#  define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#  define GL_STATIC_DRAW          0x88E4
+#endif
+
+#ifndef APIENTRY
+#  define APIENTRY
+#endif
+
+// Buffer objects are GL 1.5, which opengl32.dll does not export, so
+// their entry points are looked up once a context exists
+typedef void (APIENTRY *GenBuffersProc)(GLsizei, GLuint*);
+typedef void (APIENTRY *DeleteBuffersProc)(GLsizei, const GLuint*);
+typedef void (APIENTRY *BindBufferProc)(GLenum, GLuint);
+typedef void (APIENTRY *BufferDataProc)(GLenum, ptrdiff_t, const void*, GLenum);
+
+static GenBuffersProc    gen_buffers    = NULL;
+static DeleteBuffersProc delete_buffers = NULL;
+static BindBufferProc    bind_buffer    = NULL;
+static BufferDataProc    buffer_data    = NULL;
+
+template <class Proc>
+static void get_proc(Proc& _proc, const char* _name)
+{
+#if defined(_WIN32)
+	_proc = (Proc)wglGetProcAddress(_name);
+#elif defined(ARCH_DARWIN)
+	_proc = NULL;
+#else
+	_proc = (Proc)glXGetProcAddressARB((const GLubyte*)_name);
+#endif
+}
+
+
+MeshBuffers::MeshBuffers() :
+support_(0)
+{
+	for (int s = 0; s < N_STREAMS; s++)
+	{
+		id_[s] = 0;
+		valid_[s] = false;
+		count_[s] = 0;
+	}
+}
+
+MeshBuffers::~MeshBuffers()
+{
+	if (support_ > 0)
+		delete_buffers(N_STREAMS, id_);
+}
+
+bool MeshBuffers::init()
+{
+	if (support_ == 0)
+	{
+#if defined(ARCH_DARWIN)
+		gen_buffers = glGenBuffers;
+		delete_buffers = glDeleteBuffers;
+		bind_buffer = glBindBuffer;
+		buffer_data = (BufferDataProc)glBufferData;
+#else
+		get_proc(gen_buffers, "glGenBuffers");
+		get_proc(delete_buffers, "glDeleteBuffers");
+		get_proc(bind_buffer, "glBindBuffer");
+		get_proc(buffer_data, "glBufferData");
+#endif
+		support_ = gen_buffers && delete_buffers && bind_buffer && buffer_data ? 1 : -1;
+		if (support_ > 0)
+			gen_buffers(N_STREAMS, id_);
+	}
+	return support_ > 0;
+}
+
+void MeshBuffers::invalidate()
+{
+	for (int s = 0; s < N_STREAMS; s++)
+		valid_[s] = false;
+}
+
+void MeshBuffers::invalidate_texcoords()
+{
+	valid_[TEXCOORD] = false;
+	valid_[CORNER_TEXCOORD] = false;
+}
+
+void MeshBuffers::upload(Stream _s, const void* _data, size_t _bytes)
+{
+	if (init())
+	{
+		GLenum target = _s == INDEX ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+		bind_buffer(target, id_[_s]);
+		buffer_data(target, (ptrdiff_t)_bytes, _data, GL_STATIC_DRAW);
+		bind_buffer(target, 0);
+	}
+	else
+	{
+		data_[_s].resize(_bytes);
+		if (_bytes)
+			memcpy(&data_[_s][0], _data, _bytes);
+	}
+	valid_[_s] = true;
+}
+
+// Returns the pointer argument of the gl*Pointer / glDrawElements call:
+// an offset into the bound buffer object, or the client side copy
+const void* MeshBuffers::bind(Stream _s)
+{
+	if (support_ > 0)
+	{
+		bind_buffer(_s == INDEX ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER, id_[_s]);
+		return NULL;
+	}
+	return data_[_s].empty() ? NULL : &data_[_s][0];
+}
+
+void MeshBuffers::update_indexed(const Mesh& _mesh, const std::vector<unsigned int>& _indices,
+	bool _texcoords)
+{
+	size_t nv = _mesh.n_vertices();
+	if (!valid_[POSITION])
+	{
+		upload(POSITION, _mesh.points(), nv * sizeof(Mesh::Point));
+		upload(NORMAL, _mesh.vertex_normals(), nv * sizeof(Mesh::Normal));
+		upload(INDEX, &_indices[0], _indices.size() * sizeof(unsigned int));
+		count_[INDEX] = _indices.size();
+	}
+	if (_texcoords && !valid_[TEXCOORD])
+		upload(TEXCOORD, _mesh.texcoords2D(), nv * sizeof(Mesh::TexCoord2D));
+}
+
+void MeshBuffers::update_corners(const Mesh& _mesh, bool _texcoords)
+{
+	size_t nc = 3 * _mesh.n_faces();
+	if (!valid_[CORNER_POSITION])
+	{
+		std::vector<Mesh::Point> position;
+		std::vector<Mesh::Normal> normal;
+		position.reserve(nc);
+		normal.reserve(nc);
+
+		Mesh::ConstFaceIter f_it, f_end(_mesh.faces_end());
+		for (f_it = _mesh.faces_begin(); f_it != f_end; ++f_it)
+		{
+			for (auto fh_it = _mesh.cfh_iter(*f_it); fh_it.is_valid(); ++fh_it)
+			{
+				position.push_back(_mesh.point(_mesh.to_vertex_handle(*fh_it)));
+				normal.push_back(_mesh.normal(*f_it));
+			}
+		}
+
+		upload(CORNER_POSITION, &position[0], nc * sizeof(Mesh::Point));
+		upload(CORNER_NORMAL, &normal[0], nc * sizeof(Mesh::Normal));
+		count_[CORNER_POSITION] = nc;
+	}
+
+	if (_texcoords && !valid_[CORNER_TEXCOORD])
+	{
+		std::vector<Mesh::TexCoord2D> texcoord;
+		texcoord.reserve(nc);
+
+		Mesh::ConstFaceIter f_it, f_end(_mesh.faces_end());
+		for (f_it = _mesh.faces_begin(); f_it != f_end; ++f_it)
+		{
+			for (auto fh_it = _mesh.cfh_iter(*f_it); fh_it.is_valid(); ++fh_it)
+				texcoord.push_back(_mesh.texcoord2D(*fh_it));
+		}
+
+		upload(CORNER_TEXCOORD, &texcoord[0], nc * sizeof(Mesh::TexCoord2D));
+	}
+}
+
+void MeshBuffers::draw_indexed(const Mesh& _mesh, const std::vector<unsigned int>& _indices,
+	bool _texcoords)
+{
+	if (_indices.empty())
+		return;
+	update_indexed(_mesh, _indices, _texcoords);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, bind(POSITION));
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, 0, bind(NORMAL));
+	if (_texcoords)
+	{
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, 0, bind(TEXCOORD));
+	}
+
+	glDrawElements(GL_TRIANGLES, (GLsizei)count_[INDEX], GL_UNSIGNED_INT, bind(INDEX));
+
+	if (support_ > 0)
+	{
+		bind_buffer(GL_ARRAY_BUFFER, 0);
+		bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
+void MeshBuffers::draw_corners(const Mesh& _mesh, bool _texcoords)
+{
+	if (_mesh.n_faces() == 0)
+		return;
+	update_corners(_mesh, _texcoords);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, bind(CORNER_POSITION));
+	glEnableClientState(GL_NORMAL_ARRAY);
+	glNormalPointer(GL_FLOAT, 0, bind(CORNER_NORMAL));
+	if (_texcoords)
+	{
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, 0, bind(CORNER_TEXCOORD));
+	}
+
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)count_[CORNER_POSITION]);
+
+	if (support_ > 0)
+		bind_buffer(GL_ARRAY_BUFFER, 0);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
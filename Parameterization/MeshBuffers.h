@@ -0,0 +1,63 @@
+#pragma once
+#include "gl.hh"
+#include "MeshTypes.h"
+#include <vector>
+
+/// Vertex data of the displayed mesh in GL buffer objects, uploaded
+/// once and drawn with a single glDrawElements / glDrawArrays. Data is
+/// re-uploaded only after invalidate(). Without buffer objects
+/// (GL < 1.5) the same calls draw from client side arrays.
+class MeshBuffers
+{
+public:
+	/// vertex streams
+	enum Stream
+	{
+		POSITION,        ///< shared vertices
+		NORMAL,
+		TEXCOORD,
+		CORNER_POSITION, ///< three unshared corners per face
+		CORNER_NORMAL,   ///< face normal on every corner
+		CORNER_TEXCOORD, ///< halfedge texcoords
+		INDEX,
+		N_STREAMS
+	};
+
+public:
+	MeshBuffers();
+	~MeshBuffers();
+
+	/// the mesh changed, every stream is uploaded again
+	void invalidate();
+	/// only the texcoords changed
+	void invalidate_texcoords();
+
+	/// shared vertices with vertex normals and, if _texcoords, vertex
+	/// texcoords, indexed by the face indices of the viewer
+	void draw_indexed(const Mesh& _mesh, const std::vector<unsigned int>& _indices,
+		bool _texcoords);
+
+	/// unshared corners with face normals and, if _texcoords, halfedge
+	/// texcoords. Flat shading and per-corner texcoords both need
+	/// corners that do not share their attributes.
+	void draw_corners(const Mesh& _mesh, bool _texcoords);
+
+private:
+	bool init();
+	const void* bind(Stream _s);
+	void upload(Stream _s, const void* _data, size_t _bytes);
+	void update_indexed(const Mesh& _mesh, const std::vector<unsigned int>& _indices,
+		bool _texcoords);
+	void update_corners(const Mesh& _mesh, bool _texcoords);
+
+private:
+	// 0 = not tried yet, 1 = buffer objects, -1 = client arrays
+	int support_;
+
+	GLuint id_[N_STREAMS];
+	bool valid_[N_STREAMS];
+	size_t count_[N_STREAMS];
+
+	// client side copies, only without buffer objects
+	std::vector<unsigned char> data_[N_STREAMS];
+};
@@ -1,9 +1,13 @@
 #include "MeshPara.h"
-#include <NL/nl.h>
+#include "BinaryMesh.h"
+#include "DistortionMetrics.h"
+#include "ObjWriter.h"
+#include <sstream>
 
 
 MeshPara::MeshPara(const char* _title, int _width, int _height) :
-MeshViewer(_title, _width, _height), is_Parameterized(false)
+MeshViewer(_title, _width, _height), window_title(_title),
+is_Parameterized(false), is_Atlas(false), requested_mode(-1)
 {
 	mesh_.request_vertex_texcoords2D();
 }
@@ -18,6 +22,7 @@ void MeshPara::setup()
 
 	// add menu item
 	add_draw_mode("Texture");
+	add_draw_mode("Texture Atlas");
 
 	// setup texture
 	setup_texture();
@@ -59,7 +64,7 @@ void MeshPara::make_check_image()
 void MeshPara::draw(const std::string& _draw_mode)
 {
 	MeshViewer::draw(_draw_mode);
-	if (_draw_mode == "Texture")
+	if (_draw_mode == "Texture" || _draw_mode == "Texture Atlas")
 	{
 		if (indices_.empty())
 		{
@@ -67,250 +72,272 @@ void MeshPara::draw(const std::string& _draw_mode)
 			return ;
 		}
 
-		if (!is_Parameterized)
+		// The solve runs in the background, until it is done the last
+		// finished texture is shown, or the shaded surface if none
+		bool atlas = _draw_mode == "Texture Atlas";
+		if (!(atlas ? is_Atlas : is_Parameterized))
 		{
-			std::cout << "Have No Texture Coordinates!" << std::endl;
-			std::cout << "Need Parameterization." << std::endl;
-			LSCM();
-			std::cout << "Parameterization End." << std::endl;
-		}	
-
-		glEnable(GL_TEXTURE_2D);
-		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
-		glBindTexture(GL_TEXTURE_2D, tex_name);
-		glEnable(GL_LIGHTING);
-		//glShadeModel(GL_FLAT);
-
-		Mesh::FaceIter f_it, f_end(mesh_.faces_end());
-		glBegin(GL_TRIANGLES);
-		for (f_it = mesh_.faces_begin(); f_it != f_end; ++f_it)
-		{
-			//GL::glNormal(mesh_.normal(f_it));
-			auto fv_it = mesh_.fv_iter(*f_it);
-			while (fv_it.is_valid())
+			int mode = atlas ? AsyncParameterizer::MODE_ATLAS : AsyncParameterizer::MODE_LSCM;
+			if (requested_mode != mode)
+				start_parameterization(mode);
+
+			if (!is_Parameterized && !is_Atlas)
 			{
-				Mesh::Point pt = mesh_.point(*fv_it);
-				Mesh::TexCoord2D tx = mesh_.texcoord2D(*fv_it);
-				GL::glTexCoord(tx);
-				GL::glVertex(pt);
-				++fv_it;
+				MeshViewer::draw("Solid Smooth");
+				return;
 			}
+			atlas = is_Atlas;
 		}
-		glEnd();
 
-		glDisable(GL_TEXTURE_2D);
+		draw_texture(atlas);
 	}
 }
 
-void MeshPara::LSCM()
+void MeshPara::draw_texture(bool _atlas)
 {
-	is_Parameterized = true;
-	int nb_vertices = mesh_.n_vertices();
+	glEnable(GL_TEXTURE_2D);
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_DECAL);
+	glBindTexture(GL_TEXTURE_2D, tex_name);
+	glEnable(GL_LIGHTING);
+	//glShadeModel(GL_FLAT);
 
-	nlNewContext();
-	nlSolverParameteri(NL_SOLVER, NL_CG);
-	nlSolverParameteri(NL_PRECONDITIONER, NL_PRECOND_JACOBI);
-	nlSolverParameteri(NL_NB_VARIABLES, 2 * nb_vertices);
-	nlSolverParameteri(NL_LEAST_SQUARES, NL_TRUE);
-	nlSolverParameteri(NL_MAX_ITERATIONS, 5 * nb_vertices);
-	nlSolverParameterd(NL_THRESHOLD, 1e-10);
-	
-	nlBegin(NL_SYSTEM);
-	init_slover();
-	nlBegin(NL_MATRIX);
-	setup_LSCM();
-	nlEnd(NL_MATRIX);
-	nlEnd(NL_SYSTEM);
-	std::cout << "Solving ..." << std::endl;
-	nlSolve();
-
-	// Get results
-	get_result();
-
-	// Display time and iter_num
-	double time;
-	NLint iterations;
-	nlGetDoublev(NL_ELAPSED_TIME, &time);
-	nlGetIntergerv(NL_USED_ITERATIONS, &iterations);
-	std::cout << "Solver time: " << time << std::endl;
-	std::cout << "Used iterations: " << iterations << std::endl;
-
-	nlDeleteContext(nlGetCurrent());	
+	// the atlas has texcoords per face corner, one per chart on seams
+	if (_atlas)
+		buffers_.draw_corners(mesh_, true);
+	else
+		buffers_.draw_indexed(mesh_, indices_, true);
+
+	glDisable(GL_TEXTURE_2D);
 }
 
-// Choose an initial solution, and lock two vertices
-void MeshPara::init_slover() 
+bool MeshPara::open_mesh(const char* _filename)
 {
-	// Get bbox
-	Vec3f bAxis = bbMax - bbMin;
-
-	// Get the Projection dirction
-	int d1 ,d2, d3, i;
-	d1 = d2 = d3 = 0;
-	for (i = 1; i < 3; i++)
+	// a running solve belongs to the old mesh
+	worker_.cancel();
+
+	// a single chart result, kept for a reload of an edited version
+	std::vector<Mesh::Point> old_points;
+	std::vector<Vec2f> old_texcoords;
+	std::vector<unsigned int> old_indices;
+	if (is_Parameterized && !is_Atlas)
 	{
-		if (bAxis[i] > bAxis[d1])
-			d1 = i;
-		if (bAxis[i] < bAxis[d3])
-			d3 = i;
+		old_points.assign(mesh_.points(), mesh_.points() + mesh_.n_vertices());
+		old_texcoords.assign(mesh_.texcoords2D(), mesh_.texcoords2D() + mesh_.n_vertices());
+		old_indices = indices_;
 	}
-	for (d2 = 0; d2 < 3; d2++)
+
+	is_Parameterized = false;
+	is_Atlas = false;
+	requested_mode = -1;
+
+	// texcoords solved before and stored in a binary mesh are shown
+	// without solving again
+	BinaryMesh file;
+	if (BinaryMesh::is_binary(_filename) && file.open(_filename) &&
+		file.has(BinaryMesh::CORNER_TEXCOORDS))
+		mesh_.request_halfedge_texcoords2D();
+
+	if (!MeshViewer::open_mesh(_filename))
+		return false;
+	mesh_file = _filename;
+
+	is_Atlas = file.has(BinaryMesh::CORNER_TEXCOORDS);
+	is_Parameterized = !is_Atlas && file.has(BinaryMesh::TEXCOORDS);
+	if (!is_Atlas && !is_Parameterized && !old_indices.empty() &&
+		old_points.size() == mesh_.n_vertices() && old_indices == indices_)
+		reuse_texcoords(old_points, old_texcoords);
+	return true;
+}
+
+// Same connectivity as the last result: keep its texcoords and solve
+// again only the faces around the vertices that moved
+void MeshPara::reuse_texcoords(const std::vector<Mesh::Point>& _old_points,
+	const std::vector<Vec2f>& _old_texcoords)
+{
+	int nb_vertices = mesh_.n_vertices();
+	const Mesh::Point* points = mesh_.points();
+	std::vector<unsigned char> moved(nb_vertices);
+	for (int i = 0; i < nb_vertices; i++)
 	{
-		if (d2 != d1 && d2 != d3)
-			break;
+		moved[i] = points[i] != _old_points[i];
+		mesh_.set_texcoord2D(Mesh::VertexHandle(i), _old_texcoords[i]);
 	}
 
-	// Project vertices
-	auto v_end(mesh_.vertices_end());
-	float u1 = -1.0e30, u2 = 1.0e30;
-	int lock1 = 0, lock2 = 0;
-	for (auto v_it = mesh_.vertices_begin(); v_it != v_end; ++v_it)
+	std::vector<int> changed;
+	int nb_faces = (int)indices_.size() / 3;
+	for (int f = 0; f < nb_faces; f++)
 	{
-		float u = mesh_.point(*v_it)[d1];
-		float v = mesh_.point(*v_it)[d2];
-		int idx =  (*v_it).idx();
-		mesh_.set_texcoord2D(*v_it, Vec2f(u, v));
+		if (moved[indices_[3 * f]] || moved[indices_[3 * f + 1]] || moved[indices_[3 * f + 2]])
+			changed.push_back(f);
+	}
 
-		// set initial solution
-		nlSetVariable(2 * idx, u);
-		nlSetVariable(2 * idx + 1, v);
+	is_Parameterized = true;
+	buffers_.invalidate_texcoords();
+	if (!changed.empty())
+		LSCM(changed);
+}
 
-		if (u > u1) 
+void MeshPara::keyboard(int key, int x, int y)
+{
+	switch (key)
+	{
+	case 'c':
+	case 'C':
+		if (worker_.running())
 		{
-			lock1 = idx;
-			u1 = u;
+			// stays cancelled until a draw mode is picked again
+			worker_.cancel();
+			std::cout << "Parameterization cancelled." << std::endl;
 		}
-		if (u < u2)
+		break;
+	case 'r':
+	case 'R':
+	{
+		// the file was saved again by an editor, only the faces
+		// around the moved vertices are solved again
+		if (mesh_file.empty())
+			break;
+		std::string filename = mesh_file;
+		std::cout << "Reloading " << filename << "." << std::endl;
+		if (open_mesh(filename.c_str()))
+			glutPostRedisplay();
+		break;
+	}
+	case 'b':
+	case 'B':
+	{
+		// binary mesh with normals and the finished texcoords, it
+		// reloads without parsing or solving
+		OpenMesh::IO::Options opt = texcoord_options();
+		opt += OpenMesh::IO::Options::VertexNormal;
+		std::string filename = output_name(".pmesh");
+		std::cout << "Saving Binary Mesh to " << filename << "." << std::endl;
+		BinaryMesh::write(mesh_, filename.c_str(), opt);
+		break;
+	}
+	case 'u':
+	case 'U':
+	{
+		// only the texcoords, the geometry file did not change
+		if (!is_Parameterized && !is_Atlas)
 		{
-			lock2 = idx;
-			u2 = u;
+			std::cout << "No texcoords to save." << std::endl;
+			break;
 		}
+		std::string filename = output_name(".uv");
+		std::cout << "Saving UVs to " << filename << "." << std::endl;
+		ObjWriter(mesh_).write_uv(filename.c_str(), texcoord_options());
+		break;
+	}
+	default:
+		MeshViewer::keyboard(key, x, y);
+		break;
 	}
+}
 
-	// set locked variables
-	nlLockVariable(2 * lock1);
-	nlLockVariable(2 * lock1 + 1);
-	nlLockVariable(2 * lock2);
-	nlLockVariable(2 * lock2 + 1);
+// texcoords of the finished parameterization
+OpenMesh::IO::Options MeshPara::texcoord_options() const
+{
+	if (is_Atlas)
+		return OpenMesh::IO::Options::FaceTexCoord;
+	if (is_Parameterized)
+		return OpenMesh::IO::Options::VertexTexCoord;
+	return OpenMesh::IO::Options::Default;
 }
 
-void MeshPara::setup_LSCM()
+void MeshPara::processmenu(int i)
 {
-	auto f_it(mesh_.faces_begin());
-	auto f_end(mesh_.faces_end());
-	for (; f_it != f_end; f_it++)
-	{
-		setup_conformal_map_relations(*f_it);
-	}
+	if (!worker_.running())
+		requested_mode = -1;
+	MeshViewer::processmenu(i);
+}
+
+void MeshPara::start_parameterization(int _mode)
+{
+	requested_mode = _mode;
+	std::cout << "Parameterizing in the background, press 'c' to cancel." << std::endl;
+	worker_.start(mesh_, (AsyncParameterizer::Mode)_mode, &indices_);
+	start_timer(PROGRESS_MSECS);
 }
 
-// LSCM equation, geometric form :
-// (Z1 - Z0)(U2 - U0) = (Z2 - Z0)(U1 - U0)
-// Where Uk = uk + i.vk is the complex number 
-//                       corresponding to (u,v) coords
-//       Zk = xk + i.yk is the complex number 
-//                       corresponding to local (x,y) coords
-void MeshPara::setup_conformal_map_relations(Mesh::FHandle fh)
+// Polls the worker from the GLUT thread, which is the only one that
+// touches mesh_
+void MeshPara::timer(int _value)
 {
-	int id[3];
-	Vec3f p[3];
-	auto fv = mesh_.fv_begin(fh);
-	for (int i = 0; i < 3; i++, fv++)
+	// read running() first: the worker publishes before it stops, so
+	// a stopped worker without a result has failed or was cancelled
+	bool running = worker_.running();
+	if (worker_.apply_result(mesh_))
 	{
-		p[i] = mesh_.point(*fv);
-		id[i] = (*fv).idx();
+		is_Atlas = worker_.mode() == AsyncParameterizer::MODE_ATLAS;
+		is_Parameterized = !is_Atlas;
+		buffers_.invalidate_texcoords();
+
+		if (is_Atlas)
+			std::cout << "Charts: " << worker_.n_charts() << std::endl;
+		std::cout << "Solver time: " << worker_.solver_time() << std::endl;
+		std::cout << "Used iterations: " << worker_.used_iterations() << std::endl;
+		std::cout << worker_.telemetry().json() << std::endl;
+		print_metrics();
+
+		glutSetWindowTitle(window_title.c_str());
+		glutPostRedisplay();
+	}
+	else if (running)
+	{
+		const SolverProgress& progress = worker_.progress();
+		std::ostringstream title;
+		title << window_title << " - ";
+		if (worker_.mode() == AsyncParameterizer::MODE_ATLAS)
+			title << "charts " << progress.charts_done() << "/" << progress.charts_total() << ", ";
+		title << "iteration " << progress.iteration()
+		      << ", residual " << progress.residual();
+		glutSetWindowTitle(title.str().c_str());
+		start_timer(PROGRESS_MSECS);
+	}
+	else
+	{
+		glutSetWindowTitle(window_title.c_str());
 	}
-
-	Vec2f z[3];
-	project_triangle(p[0], p[1], p[2], z[0], z[1], z[2]);
-	Vec2f z01 = z[1] - z[0];
-	Vec2f z02 = z[2] - z[0];
-	double a = z01[0];
-	double b = z01[1];
-	double c = z02[0];
-	double d = z02[1];
-	assert(b == 0.0);
-
-	// Note  : 2*id + 0 --> u
-	//         2*id + 1 --> v
-	int u0_id = 2 * id[0];
-	int v0_id = 2 * id[0] + 1;
-	int u1_id = 2 * id[1];
-	int v1_id = 2 * id[1] + 1;
-	int u2_id = 2 * id[2];
-	int v2_id = 2 * id[2] + 1;
-
-	// Note : b = 0
-
-	// Real part
-	nlBegin(NL_ROW);
-	nlCoefficient(u0_id, -a + c);
-	nlCoefficient(v0_id, b - d);
-	nlCoefficient(u1_id, -c);
-	nlCoefficient(v1_id, d);
-	nlCoefficient(u2_id, a);
-	nlEnd(NL_ROW);
-
-	// Imaginary part
-	nlBegin(NL_ROW);
-	nlCoefficient(u0_id, -b + d);
-	nlCoefficient(v0_id, -a + c);
-	nlCoefficient(u1_id, -d);
-	nlCoefficient(v1_id, -c);
-	nlCoefficient(v2_id, a);
-	nlEnd(NL_ROW);
 }
 
-// Computes the coordinates of the vertices of a triangle
-// in a local 2D orthonormal basis of the triangle's plane.
-void MeshPara::project_triangle(Vec3f& p0, Vec3f& p1, Vec3f& p2,
-	Vec2f& z0, Vec2f& z1, Vec2f& z2)
+void MeshPara::LSCM()
 {
-	Vec3f X = p1 - p0;
-	float x1 = X.norm();
-	X.normalize();
-	Vec3f p02 = p2 - p0;
-	Vec3f Z = cross(X, p02);
-	Z.normalize();
-	Vec3f Y = cross(Z, X);
-
-	float x2 = dot(X, p02);
-	float y2 = dot(Y, p02);
-
-	z0 = Vec2f(0, 0);
-	z1 = Vec2f(x1, 0);
-	z2 = Vec2f(x2, y2);
+	start_parameterization(AsyncParameterizer::MODE_LSCM);
 }
 
-void MeshPara::get_result()
+void MeshPara::LSCM(const std::vector<int>& _changed_faces)
 {
-	Vec2f tc1, tc2;
-	tc1[0] = tc2[0] = nlGetVariable(0);
-	tc1[1] = tc2[1] = nlGetVariable(1);
-	auto v_it(mesh_.vertices_begin());
-	auto v_end(mesh_.vertices_end()); 
-	for (; v_it != v_end; v_it++)
+	// the surrounding texcoords must be a single chart result, the
+	// last one stays on screen until the region is done
+	if (!is_Parameterized || is_Atlas)
 	{
-		int idx = (*v_it).idx();
-		float u = nlGetVariable(2 * idx);
-		float v = nlGetVariable(2 * idx + 1);
-		mesh_.set_texcoord2D(*v_it, Vec2f(u, v));
-		if (u < tc1[0])tc1[0] = u;
-		if (u > tc2[0])tc2[0] = u;
-		if (v < tc1[1])tc1[1] = v;
-		if (v > tc2[1])tc2[1] = v;
+		start_parameterization(AsyncParameterizer::MODE_LSCM);
+		return;
 	}
 
-	// Normalize
-	double dx = tc2[0] - tc1[0];
-	double dy = tc2[1] - tc1[1];
-	if (dy > dx) dx = dy;
+	requested_mode = AsyncParameterizer::MODE_LSCM;
+	std::cout << "Solving " << _changed_faces.size()
+	          << " changed faces in the background, press 'c' to cancel." << std::endl;
+	worker_.start_region(mesh_, _changed_faces, &indices_);
+	start_timer(PROGRESS_MSECS);
+}
 
-	for (v_it = mesh_.vertices_begin(); v_it != v_end; v_it++)
-	{
-		Vec2f tc = mesh_.texcoord2D(*v_it);
-		tc[0] = (tc[0] - tc1[0]) / dx;
-		tc[1] = (tc[1] - tc1[1]) / dx;
-		mesh_.set_texcoord2D(*v_it, tc);
-	}
-}
\ No newline at end of file
+void MeshPara::Atlas()
+{
+	start_parameterization(AsyncParameterizer::MODE_ATLAS);
+}
+
+void MeshPara::print_metrics()
+{
+	DistortionMetrics metrics(mesh_);
+	if (!metrics.compute(is_Atlas))
+		return;
+
+	const DistortionMetrics::Summary& angle = metrics.summary(DistortionMetrics::ANGLE);
+	const DistortionMetrics::Summary& area = metrics.summary(DistortionMetrics::AREA);
+	std::cout << "Angle distortion: " << angle.mean << " mean, " << angle.max << " max" << std::endl;
+	std::cout << "Area distortion: " << area.mean << " mean, " << area.max << " max" << std::endl;
+	std::cout << "L2 stretch: " << metrics.l2_stretch() << std::endl;
+	std::cout << "Flipped faces: " << metrics.n_flipped() << std::endl;
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "MeshViewer.hh"
+#include "AsyncParameterizer.h"
+#include <OpenMesh/Core/IO/Options.hh>
 #define IMAGESIZE 128
+#define PROGRESS_MSECS 200
 
 class MeshPara : public MeshViewer
 {
@@ -11,25 +14,50 @@ public:
 	/// setup
 	void setup();
 
+	/// Open mesh, cancels a running parameterization. A new version of
+	/// a parameterized mesh (same connectivity, some vertices moved)
+	/// keeps its texcoords and is re-solved around the moved vertices,
+	/// such as the shown file reloaded with 'r' after an edit.
+	virtual bool open_mesh(const char* _filename);
+
 	/// draw the scene
 	virtual void draw(const std::string& _draw_mode);
 
-	/// LSCM Parameterization
+	/// LSCM Parameterization, in the background like the draw modes
 	void LSCM();
 
-private:
-	void init_slover();
-	void project_triangle(Vec3f& p0, Vec3f& p1, Vec3f& p2,
-		Vec2f& z0, Vec2f& z1, Vec2f& z2);
-	void setup_conformal_map_relations(Mesh::FHandle fh);
-	void setup_LSCM();
-	void get_result();
+	/// after a single chart solve, re-solve only around the faces
+	/// changed since, in the background like the draw modes
+	void LSCM(const std::vector<int>& _changed_faces);
+
+	/// LSCM per chart, packed into one texture atlas, in the background
+	void Atlas();
 
+protected:
+	virtual void keyboard(int key, int x, int y);
+	virtual void processmenu(int i);
+	virtual void timer(int _value);
+
+	/// texcoords of the finished parameterization, face texcoords of
+	/// an atlas, none before a solve
+	virtual OpenMesh::IO::Options texcoord_options() const;
+
+private:
 	void setup_texture(void);
 	void make_check_image(void);
+	void draw_texture(bool _atlas);
+	void start_parameterization(int _mode);
+	void reuse_texcoords(const std::vector<Mesh::Point>& _old_points,
+		const std::vector<Vec2f>& _old_texcoords);
+	void print_metrics();
 
 private:
+	std::string window_title;
+	std::string mesh_file;
+	AsyncParameterizer worker_;
 	bool is_Parameterized;
+	bool is_Atlas;
+	int requested_mode;
 	GLuint tex_name;
 	GLubyte check_image[IMAGESIZE][IMAGESIZE][4];
 };
@@ -1,13 +1,16 @@
 
 #include <OpenMesh/Core/IO/MeshIO.hh>
 #include "MeshViewer.hh"
+#include "BinaryMesh.h"
+#include "ObjReader.h"
+#include "ObjWriter.h"
 #include "gl.hh"
 #include <iostream>
 #include <fstream>
 
 // -----------
 MeshViewer::MeshViewer(const char* _title, int _width, int _height)
-  :GlutViewer(_title, _width, _height)
+  :GlutViewer(_title, _width, _height), output_("rst.obj")
 {
 	mesh_.request_face_normals();
 	mesh_.request_vertex_normals();
@@ -20,9 +23,56 @@ bool MeshViewer::open_mesh(const char* _filename)
   // load mesh
   //   OpenMesh::IO::Options opt = OpenMesh::IO::Options::VertexNormal;
   //    opt += OpenMesh::IO::Options::VertexTexCoord;
-  if (OpenMesh::IO::read_mesh(mesh_, _filename))
+  bool normals = false;
+  telemetry_.clear();
+  telemetry_.begin("load");
+  if (BinaryMesh::is_binary(_filename))
+  {
+    // mapped, not parsed: the box is in the header and the indices
+    // are used as they are
+    BinaryMesh file;
+    int added;
+    if (!file.open(_filename) || (added = file.build_mesh(mesh_)) < 0)
+    {
+      telemetry_.end();
+      return false;
+    }
+
+    bbMin = file.bb_min();
+    bbMax = file.bb_max();
+    normals = file.has(BinaryMesh::NORMALS);
+
+    telemetry_.begin("update_face_indices");
+    if (added == file.n_faces())
+      indices_.assign(file.indices(), file.indices() + 3 * file.n_faces());
+    else
+      update_face_indices();
+  }
+  else if (ObjReader::is_obj(_filename))
+  {
+    // the parallel reader already has the bounding box and the
+    // triangle indices, only the halfedge mesh is left to build
+    ObjReader reader;
+    if (!reader.read(_filename))
+    {
+      telemetry_.end();
+      return false;
+    }
+
+    bbMin = reader.bb_min();
+    bbMax = reader.bb_max();
+
+    int added = reader.build_mesh(mesh_);
+    telemetry_.begin("update_face_indices");
+    if (added == reader.n_faces())
+      indices_.assign(reader.faces().begin(), reader.faces().end());
+    else
+      update_face_indices();
+  }
+  else if (OpenMesh::IO::read_mesh(mesh_, _filename))
   {
     // set center and radius
+    telemetry_.begin("bbox");
     Mesh::ConstVertexIter  v_it(mesh_.vertices_begin()), 
                            v_end(mesh_.vertices_end());
 
@@ -32,22 +82,35 @@ bool MeshViewer::open_mesh(const char* _filename)
       bbMin.minimize(mesh_.point(v_it));
       bbMax.maximize(mesh_.point(v_it));
     }
-    setup_scene((Vec3f)(bbMin + bbMax)*0.5, 0.5*(bbMin - bbMax).norm());
 
-    // compute face & vertex normals
-    mesh_.update_normals();
-	
     // update face indices for faster rendering
+    telemetry_.begin("update_face_indices");
     update_face_indices();
+  }
+  else
+  {
+    telemetry_.end();
+    return false;
+  }
 
-    // info
-    std::cerr << mesh_.n_vertices() << " vertices, "
-	      << mesh_.n_faces()    << " faces\n";
+  setup_scene((Vec3f)(bbMin + bbMax)*0.5, 0.5*(bbMin - bbMax).norm());
 
-    return true;
-  }
+  // compute face & vertex normals
+  telemetry_.begin("update_normals");
+  if (normals)
+    mesh_.update_face_normals();
+  else
+    mesh_.update_normals();
+  buffers_.invalidate();
+  telemetry_.end();
+  telemetry_.set_counter("vertices", mesh_.n_vertices());
+  telemetry_.set_counter("faces", mesh_.n_faces());
 
-  return false;
+  // info
+  std::cerr << mesh_.n_vertices() << " vertices, "
+	    << mesh_.n_faces()    << " faces\n";
+
+  return true;
 }
 
 void MeshViewer::update_face_indices()
@@ -120,25 +183,11 @@ void MeshViewer::draw(const std::string& _draw_mode)
   }
   else if (_draw_mode == "Solid Flat")
   {
-    Mesh::ConstFaceIter        f_it(mesh_.faces_begin()), 
-                               f_end(mesh_.faces_end());
-    Mesh::ConstFaceVertexIter  fv_it;
-
     glEnable(GL_LIGHTING);
     glShadeModel(GL_FLAT);
 
-    glBegin(GL_TRIANGLES);
-    for (; f_it!=f_end; ++f_it)
-    {
-      GL::glNormal(mesh_.normal(f_it));
-      fv_it = mesh_.cfv_iter(f_it.handle()); 
-      GL::glVertex(mesh_.point(fv_it));
-      ++fv_it;
-      GL::glVertex(mesh_.point(fv_it));
-      ++fv_it;
-      GL::glVertex(mesh_.point(fv_it));
-    }
-    glEnd();
+    // one normal per face, so the corners cannot be shared
+    buffers_.draw_corners(mesh_, false);
   }
 
 
@@ -159,16 +208,33 @@ void MeshViewer::draw(const std::string& _draw_mode)
   }
 }
 
+std::string MeshViewer::output_name(const char* _extension) const
+{
+  size_t dot = output_.find_last_of('.');
+  size_t slash = output_.find_last_of("/\\");
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return output_ + _extension;
+  return output_.substr(0, dot) + _extension;
+}
+
+OpenMesh::IO::Options MeshViewer::texcoord_options() const
+{
+  return OpenMesh::IO::Options::VertexTexCoord;
+}
+
 void MeshViewer::keyboard(int key, int x, int y)
 {
-	OpenMesh::IO::Options opt = OpenMesh::IO::Options::VertexTexCoord;
+	OpenMesh::IO::Options opt = texcoord_options();
 
 	switch (key)
 	{
 	case 's':
 	case 'S':
-		std::cout << "Saving Mesh." << std::endl;
-		OpenMesh::IO::write_mesh(mesh_, "rst.obj", opt);
+		std::cout << "Saving Mesh to " << output_ << "." << std::endl;
+		telemetry_.begin("write");
+		ObjWriter::write_mesh(mesh_, output_, opt);
+		telemetry_.end();
+		std::cout << telemetry_.json() << std::endl;
 		break;
 	default:
 		GlutViewer::keyboard(key, x, y);
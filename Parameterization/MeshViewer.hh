@@ -34,8 +34,10 @@
 #define MESH_VIEWER_WIDGET_HH
 
 #include "GlutViewer.hh"
-#include <OpenMesh/Core/Mesh/TriMesh_ArrayKernelT.hh>
-typedef OpenMesh::TriMesh_ArrayKernelT<>  Mesh;
+#include "MeshTypes.h"
+#include "MeshBuffers.h"
+#include "Telemetry.h"
+#include <OpenMesh/Core/IO/Options.hh>
 
 class MeshViewer : public GlutViewer
 {
@@ -46,11 +48,20 @@ public:
 	/// open mesh
 	virtual bool open_mesh(const char* _filename);
 
+	/// file saved by 's', rst.obj by default, the extension picks the format
+	void set_output(const char* _filename) { output_ = _filename; }
+
 protected:
 	/// draw the scene
 	virtual void draw(const std::string& _draw_mode);
 	virtual void keyboard(int key, int x, int y);
 
+	/// output file name with another extension
+	std::string output_name(const char* _extension) const;
+
+	/// texcoords written by the saves, vertex texcoords by default
+	virtual OpenMesh::IO::Options texcoord_options() const;
+
 private:
 	/// update buffer with face indices
 	void update_face_indices();
@@ -58,7 +69,12 @@ private:
 protected:
 	Mesh  mesh_;
 	std::vector<unsigned int>  indices_;
+	MeshBuffers buffers_;
 	Mesh::Point bbMin, bbMax;
+	std::string output_;
+
+	/// stages of the last open_mesh() and of the solves and saves since
+	Telemetry telemetry_;
 };
 
 #endif 
\ No newline at end of file
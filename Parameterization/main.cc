@@ -11,6 +11,8 @@ int main(int argc, char **argv)
 
   if (argc>1)
 	  meshpara.open_mesh(argv[1]);
+  if (argc>2)
+	  meshpara.set_output(argv[2]);
 
   glutMainLoop();
 